@@ -0,0 +1,472 @@
+#pragma once
+
+#include "Types.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+namespace hs
+{
+
+//------------------------------------------------------------------------------
+// Polymorphic allocator handle used by the containers. Free gets the size of the
+// allocation so arenas and tracking allocators don't have to store headers.
+class Allocator
+{
+public:
+    //------------------------------------------------------------------------------
+    virtual ~Allocator() = default;
+
+    //------------------------------------------------------------------------------
+    virtual void* Allocate(uint64 size, uint64 alignment) = 0;
+
+    //------------------------------------------------------------------------------
+    virtual void Free(void* ptr, uint64 size) = 0;
+
+    //------------------------------------------------------------------------------
+    // Moves the allocation to a block of newSize bytes, contents are copied bitwise.
+    // Allocators which can grow in place should override this.
+    virtual void* Reallocate(void* ptr, uint64 oldSize, uint64 newSize, uint64 alignment)
+    {
+        void* newPtr = Allocate(newSize, alignment);
+        if (ptr)
+        {
+            memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+            Free(ptr, oldSize);
+        }
+        return newPtr;
+    }
+
+    //------------------------------------------------------------------------------
+    // Allocate, Free and Reallocate can be called from several threads at the same time
+    virtual bool IsThreadSafe() const
+    {
+        return false;
+    }
+};
+
+//------------------------------------------------------------------------------
+inline uint64 AlignUp(uint64 value, uint64 alignment)
+{
+    hs_assert((alignment & (alignment - 1)) == 0 && "Alignment has to be power of 2");
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//------------------------------------------------------------------------------
+// Containers which promise the compiler aligned data check what the allocator returned
+inline bool IsAligned(const void* ptr, uint64 alignment)
+{
+    return ((uint64)ptr & (alignment - 1)) == 0;
+}
+
+//------------------------------------------------------------------------------
+// Global heap. MSVC needs the _aligned_ family for over-aligned blocks and those can't be
+// mixed with free so it is used for everything there.
+class MallocAllocator : public Allocator
+{
+public:
+    //------------------------------------------------------------------------------
+    void* Allocate(uint64 size, uint64 alignment) override
+    {
+    #if defined(_MSC_VER)
+        return _aligned_malloc(size, alignment);
+    #else
+        if (alignment <= alignof(std::max_align_t))
+            return malloc(size);
+        return aligned_alloc(alignment, AlignUp(size, alignment));
+    #endif
+    }
+
+    //------------------------------------------------------------------------------
+    void Free(void* ptr, uint64) override
+    {
+    #if defined(_MSC_VER)
+        _aligned_free(ptr);
+    #else
+        free(ptr);
+    #endif
+    }
+
+    //------------------------------------------------------------------------------
+    void* Reallocate(void* ptr, uint64 oldSize, uint64 newSize, uint64 alignment) override
+    {
+    #if defined(_MSC_VER)
+        return _aligned_realloc(ptr, newSize, alignment);
+    #else
+        // realloc doesn't keep over-alignment
+        if (alignment <= alignof(std::max_align_t))
+            return realloc(ptr, newSize);
+        return Allocator::Reallocate(ptr, oldSize, newSize, alignment);
+    #endif
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsThreadSafe() const override
+    {
+        return true;
+    }
+};
+
+//------------------------------------------------------------------------------
+inline Allocator* GetDefaultAllocator()
+{
+    static MallocAllocator allocator;
+    return &allocator;
+}
+
+//------------------------------------------------------------------------------
+// Bump allocator over a single block, individual frees are no-ops and everything is
+// released at once by Reset. Meant for per-frame scratch memory. When the block runs
+// out the allocations spill to the backing allocator.
+class LinearAllocator : public Allocator
+{
+public:
+    //------------------------------------------------------------------------------
+    explicit LinearAllocator(uint64 capacity, Allocator* backing = GetDefaultAllocator())
+        : backing_(backing)
+        , capacity_(capacity)
+    {
+        memory_ = (byte*)backing_->Allocate(capacity_, alignof(std::max_align_t));
+    }
+
+    //------------------------------------------------------------------------------
+    ~LinearAllocator()
+    {
+        backing_->Free(memory_, capacity_);
+    }
+
+    //------------------------------------------------------------------------------
+    LinearAllocator(const LinearAllocator&) = delete;
+
+    //------------------------------------------------------------------------------
+    LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+    //------------------------------------------------------------------------------
+    void* Allocate(uint64 size, uint64 alignment) override
+    {
+        // The block itself is only max_align_t aligned, align the address not the offset
+        uint64 offset = AlignUp((uint64)(memory_ + top_), alignment) - (uint64)memory_;
+        if (offset + size > capacity_)
+            return backing_->Allocate(size, alignment);
+
+        top_ = offset + size;
+        return memory_ + offset;
+    }
+
+    //------------------------------------------------------------------------------
+    void Free(void* ptr, uint64 size) override
+    {
+        if (!Owns(ptr))
+            backing_->Free(ptr, size);
+    }
+
+    //------------------------------------------------------------------------------
+    // The most recent allocation is grown in place
+    void* Reallocate(void* ptr, uint64 oldSize, uint64 newSize, uint64 alignment) override
+    {
+        if (ptr && Owns(ptr) && (byte*)ptr + oldSize == memory_ + top_ && ((uint64)ptr & (alignment - 1)) == 0)
+        {
+            uint64 offset = (byte*)ptr - memory_;
+            if (offset + newSize <= capacity_)
+            {
+                top_ = offset + newSize;
+                return ptr;
+            }
+        }
+
+        return Allocator::Reallocate(ptr, oldSize, newSize, alignment);
+    }
+
+    //------------------------------------------------------------------------------
+    // Invalidates all allocations made from the block
+    void Reset()
+    {
+        top_ = 0;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 GetUsed() const
+    {
+        return top_;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 GetCapacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    Allocator* backing_;
+    byte* memory_{};
+    uint64 capacity_{};
+    uint64 top_{};
+
+    //------------------------------------------------------------------------------
+    // The end of the block is included, zero sized requests get it once the block is full
+    bool Owns(void* ptr) const
+    {
+        return ptr >= memory_ && ptr <= memory_ + capacity_;
+    }
+};
+
+//------------------------------------------------------------------------------
+// Fixed size blocks recycled through a free list. Blocks are aligned to the largest
+// power of 2 dividing the block size up to CACHE_LINE_SIZE. Requests bigger than the
+// block size or aligned above the blocks go to the backing allocator.
+class PoolAllocator : public Allocator
+{
+public:
+    //------------------------------------------------------------------------------
+    PoolAllocator(uint64 blockSize, uint64 blocksPerPage, Allocator* backing = GetDefaultAllocator())
+        : backing_(backing)
+        , blockSize_(AlignUp(blockSize < sizeof(void*) ? sizeof(void*) : blockSize, alignof(std::max_align_t)))
+        , blockAlignment_(BlockAlignment(blockSize_))
+        , blocksPerPage_(blocksPerPage)
+    {
+    }
+
+    //------------------------------------------------------------------------------
+    ~PoolAllocator()
+    {
+        while (pages_)
+        {
+            Page* next = pages_->next_;
+            backing_->Free(pages_, PageSize());
+            pages_ = next;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    PoolAllocator(const PoolAllocator&) = delete;
+
+    //------------------------------------------------------------------------------
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    //------------------------------------------------------------------------------
+    void* Allocate(uint64 size, uint64 alignment) override
+    {
+        if (size > blockSize_)
+            return backing_->Allocate(size, alignment);
+
+        if (alignment > blockAlignment_)
+        {
+            // Free can't tell these from blocks by size, it has to look at the pages while any exist
+            ++foreignCount_;
+            return backing_->Allocate(size, alignment);
+        }
+
+        if (!freeList_)
+            AddPage();
+
+        FreeBlock* block = freeList_;
+        freeList_ = block->next_;
+        return block;
+    }
+
+    //------------------------------------------------------------------------------
+    void Free(void* ptr, uint64 size) override
+    {
+        if (!ptr)
+            return;
+
+        if (size > blockSize_ || (foreignCount_ && !OwnsBlock(ptr)))
+        {
+            if (size <= blockSize_)
+                --foreignCount_;
+            backing_->Free(ptr, size);
+            return;
+        }
+
+        FreeBlock* block = (FreeBlock*)ptr;
+        block->next_ = freeList_;
+        freeList_ = block;
+    }
+
+    //------------------------------------------------------------------------------
+    void* Reallocate(void* ptr, uint64 oldSize, uint64 newSize, uint64 alignment) override
+    {
+        // Still fits the block it is in
+        if (ptr && oldSize <= blockSize_ && newSize <= blockSize_ && alignment <= blockAlignment_ && (!foreignCount_ || OwnsBlock(ptr)))
+            return ptr;
+
+        return Allocator::Reallocate(ptr, oldSize, newSize, alignment);
+    }
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next_;
+    };
+
+    struct alignas(std::max_align_t) Page
+    {
+        Page* next_;
+    };
+
+    Allocator* backing_;
+    uint64 blockSize_;
+    uint64 blockAlignment_;
+    uint64 blocksPerPage_;
+    Page* pages_{};
+    FreeBlock* freeList_{};
+    uint64 foreignCount_{};
+
+    //------------------------------------------------------------------------------
+    static uint64 BlockAlignment(uint64 blockSize)
+    {
+        const uint64 alignment = blockSize & (0 - blockSize);
+        return alignment < CACHE_LINE_SIZE ? alignment : CACHE_LINE_SIZE;
+    }
+
+    //------------------------------------------------------------------------------
+    // Blocks start after the page header padded to the block alignment
+    uint64 BlocksOffset() const
+    {
+        return AlignUp(sizeof(Page), blockAlignment_);
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 PageSize() const
+    {
+        return BlocksOffset() + blockSize_ * blocksPerPage_;
+    }
+
+    //------------------------------------------------------------------------------
+    bool OwnsBlock(void* ptr) const
+    {
+        for (Page* page = pages_; page; page = page->next_)
+        {
+            byte* blocks = (byte*)page + BlocksOffset();
+            if (ptr >= blocks && ptr < blocks + blockSize_ * blocksPerPage_)
+                return true;
+        }
+        return false;
+    }
+
+    //------------------------------------------------------------------------------
+    void AddPage()
+    {
+        Page* page = (Page*)backing_->Allocate(PageSize(), blockAlignment_ > alignof(Page) ? blockAlignment_ : alignof(Page));
+        page->next_ = pages_;
+        pages_ = page;
+
+        byte* blocks = (byte*)page + BlocksOffset();
+        for (uint64 i = 0; i < blocksPerPage_; ++i)
+        {
+            FreeBlock* block = (FreeBlock*)(blocks + i * blockSize_);
+            block->next_ = freeList_;
+            freeList_ = block;
+        }
+    }
+};
+
+//------------------------------------------------------------------------------
+// Forwards to the backing allocator and counts what goes through
+class TrackingAllocator : public Allocator
+{
+public:
+    //------------------------------------------------------------------------------
+    explicit TrackingAllocator(Allocator* backing = GetDefaultAllocator())
+        : backing_(backing)
+    {
+    }
+
+    //------------------------------------------------------------------------------
+    void* Allocate(uint64 size, uint64 alignment) override
+    {
+        ++allocationCount_;
+        bytesAllocated_ += size;
+        if (size > largestSize_)
+            largestSize_ = size;
+        liveBytes_ += size;
+        if (liveBytes_ > peakBytes_)
+            peakBytes_ = liveBytes_;
+
+        return backing_->Allocate(size, alignment);
+    }
+
+    //------------------------------------------------------------------------------
+    void Free(void* ptr, uint64 size) override
+    {
+        if (!ptr)
+            return;
+
+        ++freeCount_;
+        liveBytes_ -= size;
+        backing_->Free(ptr, size);
+    }
+
+    //------------------------------------------------------------------------------
+    void* Reallocate(void* ptr, uint64 oldSize, uint64 newSize, uint64 alignment) override
+    {
+        if (!ptr)
+            return Allocate(newSize, alignment);
+
+        ++reallocationCount_;
+        bytesAllocated_ += newSize;
+        if (newSize > largestSize_)
+            largestSize_ = newSize;
+        liveBytes_ += newSize - oldSize;
+        if (liveBytes_ > peakBytes_)
+            peakBytes_ = liveBytes_;
+
+        return backing_->Reallocate(ptr, oldSize, newSize, alignment);
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 GetAllocationCount() const
+    {
+        return allocationCount_;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 GetFreeCount() const
+    {
+        return freeCount_;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 GetReallocationCount() const
+    {
+        return reallocationCount_;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 GetBytesAllocated() const
+    {
+        return bytesAllocated_;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 GetLiveBytes() const
+    {
+        return liveBytes_;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 GetPeakBytes() const
+    {
+        return peakBytes_;
+    }
+
+    //------------------------------------------------------------------------------
+    // Biggest single block requested, e.g. for sizing a PoolAllocator
+    uint64 GetLargestSize() const
+    {
+        return largestSize_;
+    }
+
+private:
+    Allocator* backing_;
+    uint64 allocationCount_{};
+    uint64 freeCount_{};
+    uint64 reallocationCount_{};
+    uint64 bytesAllocated_{};
+    uint64 liveBytes_{};
+    uint64 peakBytes_{};
+    uint64 largestSize_{};
+};
+
+}
@@ -2,17 +2,55 @@
 
 #include "Types.h"
 #include "ps_Math.h"
+#include "Allocator.h"
+#include "Span.h"
 
 #include <cassert>
 #include <initializer_list>
+#include <new>
 #include <utility>
 
+// Per array instrumentation of reallocations, off by default
+#ifndef HS_ARRAY_STATS
+    #define HS_ARRAY_STATS 0
+#endif
+
 namespace hs
 {
+
 //------------------------------------------------------------------------------
-template<class T>
+enum class ArrayGrowth : uint8
+{
+    Double,     // Fewer reallocations
+    OneAndHalf, // Less unused capacity, freed blocks can be reused by later growth
+};
+
+//------------------------------------------------------------------------------
+// Capacity after the next growth step
+inline uint64 GrowCapacity(uint64 capacity, ArrayGrowth growth, uint64 minCapacity)
+{
+    const uint64 grown = growth == ArrayGrowth::Double ? capacity << 1 : capacity + (capacity >> 1);
+    return grown > minCapacity ? grown : minCapacity;
+}
+
+//------------------------------------------------------------------------------
+struct ArrayStats
+{
+    uint64 reallocations_{};
+    uint64 bytesCopied_{}; // Upper bound, realloc may extend the block in place
+    uint64 peakCapacity_{};
+};
+
+//------------------------------------------------------------------------------
+// Alignment over alignof(T) makes the buffer start on that boundary and pads the
+// capacity to whole multiples of it, e.g. 32 for AVX loads or 64 (CACHE_LINE_SIZE)
+// so no other data shares the cache lines of the array between threads.
+template<class T, uint64 Alignment = alignof(T)>
 class Array
 {
+    static_assert((Alignment & (Alignment - 1)) == 0, "Alignment has to be power of 2");
+    static_assert(Alignment >= alignof(T), "Alignment can't be lower than the natural alignment of T");
+
 public:
     //------------------------------------------------------------------------------
     static constexpr uint64 IndexBad()
@@ -24,8 +62,18 @@ public:
     Array() = default;
 
     //------------------------------------------------------------------------------
-    Array(std::initializer_list<T> elements)
+    explicit Array(Allocator* allocator)
+        : allocator_(allocator)
+    {
+        hs_assert(allocator_);
+    }
+
+    //------------------------------------------------------------------------------
+    Array(std::initializer_list<T> elements, Allocator* allocator = GetDefaultAllocator())
+        : allocator_(allocator)
     {
+        hs_assert(allocator_);
+        Reserve(elements.size());
         for (auto&& e : elements)
         {
             Add(std::forward<decltype(e)>(e));
@@ -39,44 +87,53 @@ public:
             items_[i].~T();
         count_ = 0;
 
+        FreeItems(items_, capacity_);
         capacity_ = 0;
-        free(items_);
     }
 
     //------------------------------------------------------------------------------
-    Array(const Array<T>& other)
+    // The copy uses the allocator and growth of the source array
+    Array(const Array& other)
+        : allocator_(other.allocator_)
+        , growth_(other.growth_)
     {
         capacity_ = other.capacity_;
         count_ = other.count_;
 
-        items_ = (T*)malloc(sizeof(T) * capacity_);
+        items_ = capacity_ ? AllocateItems(capacity_) : nullptr;
         for (int i = 0; i < count_; ++i)
         {
-            items_[i] = other.items_[i];
+            new(items_ + i) T(other.items_[i]);
         }
     }
 
     //------------------------------------------------------------------------------
-    Array<T>& operator=(const Array<T>& other)
+    // Keeps the allocator of this array
+    Array& operator=(const Array& other)
     {
+        if (this == &other)
+            return *this;
+
         for (int i = 0; i < count_; ++i)
             items_[i].~T();
-        free(items_);
+        FreeItems(items_, capacity_);
 
         capacity_ = other.capacity_;
         count_ = other.count_;
 
-        items_ = (T*)malloc(sizeof(T) * capacity_);
+        items_ = capacity_ ? AllocateItems(capacity_) : nullptr;
         for (int i = 0; i < count_; ++i)
         {
-            items_[i] = other.items_[i];
+            new(items_ + i) T(other.items_[i]);
         }
 
         return *this;
     }
 
     //------------------------------------------------------------------------------
-    Array(Array<T>&& other)
+    Array(Array&& other)
+        : allocator_(other.allocator_)
+        , growth_(other.growth_)
     {
         capacity_ = other.capacity_;
         count_ = other.count_;
@@ -88,12 +145,18 @@ public:
     }
 
     //------------------------------------------------------------------------------
-    Array<T>& operator=(Array<T>&& other)
+    // Takes over the memory together with the allocator it came from
+    Array& operator=(Array&& other)
     {
+        if (this == &other)
+            return *this;
+
         for (int i = 0; i < count_; ++i)
             items_[i].~T();
-        free(items_);
+        FreeItems(items_, capacity_);
 
+        allocator_ = other.allocator_;
+        growth_ = other.growth_;
         capacity_ = other.capacity_;
         count_ = other.count_;
         items_ = other.items_;
@@ -105,12 +168,44 @@ public:
         return *this;
     }
 
+    //------------------------------------------------------------------------------
+    Allocator* GetAllocator() const
+    {
+        return allocator_;
+    }
+
+    //------------------------------------------------------------------------------
+    void SetGrowth(ArrayGrowth growth)
+    {
+        growth_ = growth;
+    }
+
+    //------------------------------------------------------------------------------
+    ArrayGrowth GetGrowth() const
+    {
+        return growth_;
+    }
+
     //------------------------------------------------------------------------------
     uint64 Count() const
     {
         return count_;
     }
 
+    //------------------------------------------------------------------------------
+    uint64 Capacity() const
+    {
+        return capacity_;
+    }
+
+#if HS_ARRAY_STATS
+    //------------------------------------------------------------------------------
+    const ArrayStats& GetStats() const
+    {
+        return stats_;
+    }
+#endif
+
     //------------------------------------------------------------------------------
     bool IsEmpty() const
     {
@@ -135,28 +230,8 @@ public:
     template<class ...ArgsT>
     void EmplaceBack(ArgsT ...args)
     {
-        // Check for aliasing
         if (count_ == capacity_)
-        {
-            capacity_ = ArrMax(capacity_ << 1, MIN_CAPACITY);
-            
-            T* newItems = (T*)malloc(sizeof(T) * capacity_);
-
-            if (std::is_trivial_v<T>)
-            {
-                memcpy(newItems, items_, sizeof(T) * count_);
-            }
-            else
-            {
-                for (int i = 0; i < count_; ++i)
-                {
-                    new(newItems + i) T(std::move(items_[i]));
-                    items_[i].~T();
-                }
-            }
-            free(items_);
-            items_ = newItems;
-        }
+            SetCapacity(NextCapacity());
 
         hs_assert(count_ < capacity_);
 
@@ -175,50 +250,45 @@ public:
             return;
         }
 
-        if (count_ == capacity_)
+        if constexpr (IsTriviallyRelocatable_v<T>)
+        {
+            if (count_ == capacity_)
+                SetCapacity(NextCapacity());
+
+            // Relocate the tail by one to the right, the hole is treated as raw memory
+            memmove(&items_[index + 1], &items_[index], (count_ - index) * sizeof(T));
+            new(items_ + index) T(std::forward<ArgsT>(args)...);
+        }
+        else if (count_ == capacity_)
         {
-            capacity_ = ArrMax(capacity_ << 1, MIN_CAPACITY);
+            const uint64 oldCapacity = capacity_;
+            capacity_ = PadCapacity(NextCapacity());
+            RecordReallocation();
 
-            auto newItems = (T*)malloc(sizeof(T) * capacity_);
-            if (std::is_trivial_v<T>)
+            auto newItems = AllocateItems(capacity_);
+            for (int i = 0; i < index; ++i)
             {
-                memcpy(newItems, items_, sizeof(T) * index);
-                memcpy(&newItems[index + 1], &items_[index], (count_ - index) * sizeof(T));
+                new(newItems + i) T(std::move(items_[i]));
+                items_[i].~T();
             }
-            else
+            for (int i = index; i < count_; ++i)
             {
-                for (int i = 0; i < index; ++i)
-                {
-                    new(newItems + i) T(std::move(items_[i]));
-                    items_[i].~T();
-                }
-                for (int i = index; i < count_; ++i)
-                {
-                    new(newItems + i + 1) T(std::move(items_[i]));
-                    items_[i].~T();
-                }
+                new(newItems + i + 1) T(std::move(items_[i]));
+                items_[i].~T();
             }
 
-            free(items_);
+            FreeItems(items_, oldCapacity);
             items_ = newItems;
             new(items_ + index) T(std::forward<ArgsT>(args)...);
         }
         else
         {
-            // Move items by one to the right
-            if (std::is_trivial_v<T>)
-            {
-                memmove(&items_[index + 1], &items_[index], (count_ - index) * sizeof(T));
-            }
-            else
-            {
-                // count_ is at least 1, otherwise there is early exit
-                // New last place is not initialized item, move construct there
-                new(items_ + count_) T(std::move(items_[count_ - 1]));
-                // Other items can be move assigned
-                for (T* item = items_ + count_- 1; item != items_ + index; --item)
-                    *item = std::move(*(item - 1));
-            }
+            // count_ is at least 1, otherwise there is early exit
+            // New last place is not initialized item, move construct there
+            new(items_ + count_) T(std::move(items_[count_ - 1]));
+            // Other items can be move assigned
+            for (T* item = items_ + count_- 1; item != items_ + index; --item)
+                *item = std::move(*(item - 1));
 
             items_[index] = T(std::forward<ArgsT>(args)...);
         }
@@ -264,9 +334,10 @@ public:
     {
         hs_assert(index < count_);
 
-        if (std::is_trivial_v<T>)
+        if constexpr (IsTriviallyRelocatable_v<T>)
         {
-            memmove(&items_[index], &items_[index + 1], (count_ - index) * sizeof(T));
+            items_[index].~T();
+            memmove(&items_[index], &items_[index + 1], (count_ - index - 1) * sizeof(T));
         }
         else
         {
@@ -278,6 +349,221 @@ public:
         --count_;
     }
 
+    //------------------------------------------------------------------------------
+    // O(1) remove which moves the last item into the hole, doesn't keep the order
+    void RemoveSwapBack(uint64 index)
+    {
+        hs_assert(index < count_);
+
+        const uint64 last = count_ - 1;
+        if (index != last)
+        {
+            if constexpr (IsTriviallyRelocatable_v<T>)
+            {
+                items_[index].~T();
+                memcpy((void*)&items_[index], &items_[last], sizeof(T));
+            }
+            else
+            {
+                items_[index] = std::move(items_[last]);
+                items_[last].~T();
+            }
+        }
+        else
+        {
+            items_[last].~T();
+        }
+
+        --count_;
+    }
+
+    //------------------------------------------------------------------------------
+    // Removes all items matching the predicate in one pass keeping the order of the rest,
+    // returns number of removed items
+    template<class TPred>
+    uint64 RemoveIf(TPred pred)
+    {
+        uint64 write = 0;
+        for (uint64 read = 0; read < count_; ++read)
+        {
+            if (pred(items_[read]))
+            {
+                if constexpr (IsTriviallyRelocatable_v<T>)
+                    items_[read].~T();
+                continue;
+            }
+
+            if (write != read)
+            {
+                if constexpr (IsTriviallyRelocatable_v<T>)
+                    memcpy((void*)&items_[write], &items_[read], sizeof(T));
+                else
+                    items_[write] = std::move(items_[read]);
+            }
+            ++write;
+        }
+
+        return Compact(write);
+    }
+
+    //------------------------------------------------------------------------------
+    // Removes items at the given indices in one pass keeping the order of the rest.
+    // Indices have to be sorted ascending and unique.
+    void RemoveIndices(Span<const uint64> indices)
+    {
+        if (indices.IsEmpty())
+            return;
+
+        uint64 write = indices[0];
+        for (uint64 i = 0; i < indices.Count(); ++i)
+        {
+            const uint64 removed = indices[i];
+            hs_assert(removed < count_);
+            hs_assert((i == 0 || indices[i - 1] < removed) && "Indices have to be sorted and unique");
+
+            // Run of kept items between this and the next removed index
+            const uint64 runBegin = removed + 1;
+            const uint64 runEnd = i + 1 < indices.Count() ? indices[i + 1] : count_;
+
+            if constexpr (IsTriviallyRelocatable_v<T>)
+            {
+                items_[removed].~T();
+                memmove((void*)&items_[write], &items_[runBegin], (runEnd - runBegin) * sizeof(T));
+                write += runEnd - runBegin;
+            }
+            else
+            {
+                for (uint64 read = runBegin; read < runEnd; ++read)
+                    items_[write++] = std::move(items_[read]);
+            }
+        }
+
+        Compact(write);
+    }
+
+    //------------------------------------------------------------------------------
+    // Copies all the items to the end of the array, grows at most once
+    void AddRange(Span<const T> items)
+    {
+        InsertRange(count_, items);
+    }
+
+    //------------------------------------------------------------------------------
+    void InsertRange(uint64 index, Span<const T> items)
+    {
+        hs_assert(index <= count_);
+        hs_assert((items.Data() + items.Count() <= items_ || items.Data() >= items_ + capacity_) && "Inserting items from array to itself is not handled");
+
+        const uint64 n = items.Count();
+        if (n == 0)
+            return;
+
+        EnsureCapacity(count_ + n);
+
+        if constexpr (IsTriviallyRelocatable_v<T>)
+        {
+            memmove(&items_[index + n], &items_[index], (count_ - index) * sizeof(T));
+            CopyConstruct(items_ + index, items.Data(), n);
+        }
+        else
+        {
+            // Shift the tail, slots past count_ are raw memory so they get constructed
+            for (uint64 i = count_; i-- > index;)
+            {
+                const uint64 dst = i + n;
+                if (dst >= count_)
+                    new(items_ + dst) T(std::move(items_[i]));
+                else
+                    items_[dst] = std::move(items_[i]);
+            }
+
+            for (uint64 i = 0; i < n; ++i)
+            {
+                const uint64 dst = index + i;
+                if (dst < count_)
+                    items_[dst] = items[i];
+                else
+                    new(items_ + dst) T(items[i]);
+            }
+        }
+
+        count_ += n;
+    }
+
+    //------------------------------------------------------------------------------
+    void RemoveRange(uint64 index, uint64 count)
+    {
+        hs_assert(index + count <= count_);
+
+        if (count == 0)
+            return;
+
+        if constexpr (IsTriviallyRelocatable_v<T>)
+        {
+            for (uint64 i = index; i < index + count; ++i)
+                items_[i].~T();
+            memmove(&items_[index], &items_[index + count], (count_ - index - count) * sizeof(T));
+        }
+        else
+        {
+            for (uint64 i = index + count; i < count_; ++i)
+                items_[i - count] = std::move(items_[i]);
+            for (uint64 i = count_ - count; i < count_; ++i)
+                items_[i].~T();
+        }
+
+        count_ -= count;
+    }
+
+    //------------------------------------------------------------------------------
+    // New items are value initialized (zeroed for trivial types), grows geometrically like Add
+    void Resize(uint64 count)
+    {
+        if (count < count_)
+        {
+            RemoveRange(count, count_ - count);
+            return;
+        }
+
+        EnsureCapacity(count);
+        for (uint64 i = count_; i < count; ++i)
+            new(items_ + i) T();
+        count_ = count;
+    }
+
+    //------------------------------------------------------------------------------
+    // New items are default initialized, trivial types are left with garbage
+    void ResizeUninitialized(uint64 count)
+    {
+        if (count < count_)
+        {
+            RemoveRange(count, count_ - count);
+            return;
+        }
+
+        EnsureCapacity(count);
+        if constexpr (!std::is_trivially_default_constructible_v<T>)
+        {
+            for (uint64 i = count_; i < count; ++i)
+                new(items_ + i) T;
+        }
+        count_ = count;
+    }
+
+    //------------------------------------------------------------------------------
+    // Adds count value initialized items and returns them to be filled in
+    Span<T> AppendDefault(uint64 count)
+    {
+        EnsureCapacity(count_ + count);
+
+        T* appended = items_ + count_;
+        for (uint64 i = 0; i < count; ++i)
+            new(appended + i) T();
+        count_ += count;
+
+        return Span<T>(appended, count);
+    }
+
     //------------------------------------------------------------------------------
     void RemoveLast()
     {
@@ -294,31 +580,37 @@ public:
         count_ = 0;
     }
 
+    //------------------------------------------------------------------------------
+    // Destroys all items and releases the memory
+    void Reset()
+    {
+        Clear();
+        FreeItems(items_, capacity_);
+        items_ = nullptr;
+        capacity_ = 0;
+    }
+
     //------------------------------------------------------------------------------
     void Reserve(uint64 capacity)
     {
         if (capacity <= capacity_)
             return;
 
-        auto oldCapacity = capacity_;
-        capacity_ = ArrMax(capacity, MIN_CAPACITY);
+        SetCapacity(ArrMax(capacity, MIN_CAPACITY));
+    }
 
-        T* newItems = (T*)malloc(sizeof(T) * capacity_);
-        if (std::is_trivial_v<T>)
-        {
-            memcpy(newItems, items_, sizeof(T) * oldCapacity);
-        }
-        else
+    //------------------------------------------------------------------------------
+    // Reallocates to the smallest capacity holding the current items
+    void ShrinkToFit()
+    {
+        if (count_ == 0)
         {
-            for (int i = 0; i < count_; ++i)
-            {
-                new(newItems + i) T(std::move(items_[i]));
-                items_[i].~T();
-            }
+            Reset();
+            return;
         }
 
-        free(items_);
-        items_ = newItems;
+        if (PadCapacity(count_) < capacity_)
+            SetCapacity(count_);
     }
 
     //------------------------------------------------------------------------------
@@ -352,7 +644,29 @@ public:
     //------------------------------------------------------------------------------
     T* Data() const
     {
-        return items_;
+        return HS_ASSUME_ALIGNED(items_, Alignment);
+    }
+
+    //------------------------------------------------------------------------------
+    // View of the elements, e.g. to slice or split them between threads
+    Span<T> AsSpan() const
+    {
+        return Span<T>(Data(), count_);
+    }
+
+    //------------------------------------------------------------------------------
+    static constexpr uint64 GetAlignment()
+    {
+        return Alignment;
+    }
+
+    //------------------------------------------------------------------------------
+    // Count rounded up to whole Alignment sized blocks, it always fits the capacity so
+    // SIMD kernels can process the tail with full width loads. Items past Count are
+    // not initialized.
+    uint64 PaddedCount() const
+    {
+        return PadCapacity(count_);
     }
 
     //------------------------------------------------------------------------------
@@ -383,13 +697,127 @@ public:
 
 private:
     static constexpr uint64 MIN_CAPACITY = 8;
+    // Capacity is kept a multiple of this so the allocation ends on the alignment boundary
+    static constexpr uint64 CAPACITY_GRANULARITY = Alignment > alignof(T) && Alignment % sizeof(T) == 0 ? Alignment / sizeof(T) : 1;
 
+    Allocator* allocator_{ GetDefaultAllocator() };
     uint64 capacity_{};
     uint64 count_{};
     T* items_{};
+    ArrayGrowth growth_{ ArrayGrowth::Double };
+#if HS_ARRAY_STATS
+    ArrayStats stats_;
+#endif
+
+    //------------------------------------------------------------------------------
+    T* AllocateItems(uint64 capacity)
+    {
+        T* items = (T*)allocator_->Allocate(sizeof(T) * capacity, Alignment);
+        hs_assert(IsAligned(items, Alignment) && "Allocator doesn't honor the alignment");
+        return items;
+    }
+
+    //------------------------------------------------------------------------------
+    void FreeItems(T* items, uint64 capacity)
+    {
+        if (items)
+            allocator_->Free(items, sizeof(T) * capacity);
+    }
+
+    //------------------------------------------------------------------------------
+    // Finishes compaction which left first newCount items valid, relocatable types have
+    // the removed items already destroyed
+    uint64 Compact(uint64 newCount)
+    {
+        if constexpr (!IsTriviallyRelocatable_v<T>)
+        {
+            for (uint64 i = newCount; i < count_; ++i)
+                items_[i].~T();
+        }
+
+        const uint64 removed = count_ - newCount;
+        count_ = newCount;
+        return removed;
+    }
+
+    //------------------------------------------------------------------------------
+    // Grows geometrically so repeated range adds stay amortized
+    void EnsureCapacity(uint64 capacity)
+    {
+        if (capacity <= capacity_)
+            return;
+
+        SetCapacity(ArrMax(capacity, NextCapacity()));
+    }
+
+    //------------------------------------------------------------------------------
+    static void CopyConstruct(T* dst, const T* src, uint64 count)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            memcpy(dst, src, count * sizeof(T));
+        }
+        else
+        {
+            for (uint64 i = 0; i < count; ++i)
+                new(dst + i) T(src[i]);
+        }
+    }
 
     //------------------------------------------------------------------------------
-    uint64 ArrMax(uint64 a, uint64 b)
+    uint64 NextCapacity() const
+    {
+        return GrowCapacity(capacity_, growth_, MIN_CAPACITY);
+    }
+
+    //------------------------------------------------------------------------------
+    void RecordReallocation()
+    {
+    #if HS_ARRAY_STATS
+        ++stats_.reallocations_;
+        stats_.bytesCopied_ += count_ * sizeof(T);
+        stats_.peakCapacity_ = ArrMax(stats_.peakCapacity_, capacity_);
+    #endif
+    }
+
+    //------------------------------------------------------------------------------
+    // Relocatable types are moved by the allocator in one go (realloc can often resize
+    // the block in place), the rest is move constructed element by element
+    void SetCapacity(uint64 capacity)
+    {
+        capacity = PadCapacity(capacity);
+        hs_assert(capacity >= count_);
+
+        if constexpr (IsTriviallyRelocatable_v<T>)
+        {
+            items_ = (T*)allocator_->Reallocate(items_, sizeof(T) * capacity_, sizeof(T) * capacity, Alignment);
+            hs_assert(IsAligned(items_, Alignment) && "Allocator doesn't honor the alignment");
+        }
+        else
+        {
+            T* newItems = AllocateItems(capacity);
+            for (uint64 i = 0; i < count_; ++i)
+            {
+                new(newItems + i) T(std::move(items_[i]));
+                items_[i].~T();
+            }
+
+            FreeItems(items_, capacity_);
+            items_ = newItems;
+        }
+
+        capacity_ = capacity;
+        RecordReallocation();
+    }
+
+    //------------------------------------------------------------------------------
+    static constexpr uint64 PadCapacity(uint64 capacity)
+    {
+        return (capacity + CAPACITY_GRANULARITY - 1) / CAPACITY_GRANULARITY * CAPACITY_GRANULARITY;
+    }
+
+    //------------------------------------------------------------------------------
+    static uint64 ArrMax(uint64 a, uint64 b)
     {
         return a > b ? a : b;
     }
@@ -397,3 +825,6 @@ private:
 
 }
 
+//------------------------------------------------------------------------------
+template<class T, uint64 Alignment>
+struct IsTriviallyRelocatable<hs::Array<T, Alignment>> : std::true_type {};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Array.h"
+#include "ps_Math.h"
+
+#include <cassert>
+#include <utility>
+
+using namespace hs;
+
+//------------------------------------------------------------------------------
+// Calendar queue for integer keys which don't go below the last removed one. A ring of
+// BucketCount buckets each covering BucketWidth consecutive keys, a key lands in bucket
+// (key / width) % count. Removing scans from the current bucket and takes the lowest key
+// of the current window, keys a whole round or more ahead wait in the same buckets.
+// When keys stay within count * width of the last removed one (Dial's algorithm with
+// width 1) add and remove are O(1) plus skipping empty buckets, after a full round with
+// nothing found the cursor jumps straight to the minimum.
+template<class Value_t>
+class BucketQueue
+{
+public:
+    using Key_t = uint;
+
+    struct Entry
+    {
+        Key_t key_;
+        Value_t value_;
+    };
+
+    //------------------------------------------------------------------------------
+    // Both have to be powers of 2
+    explicit BucketQueue(uint bucketCount = 1024, uint bucketWidth = 1, Allocator* allocator = GetDefaultAllocator())
+        : buckets_(allocator)
+        , bucketMask_(bucketCount - 1)
+        , widthShift_(Log2Floor64(bucketWidth))
+    {
+        assert(bucketCount && (bucketCount & (bucketCount - 1)) == 0);
+        assert(bucketWidth && (bucketWidth & (bucketWidth - 1)) == 0);
+
+        buckets_.Reserve(bucketCount);
+        for (uint i = 0; i < bucketCount; ++i)
+            buckets_.EmplaceBack(allocator);
+    }
+
+    //------------------------------------------------------------------------------
+    size_t Count() const
+    {
+        return count_;
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsEmpty() const
+    {
+        return count_ == 0;
+    }
+
+    //------------------------------------------------------------------------------
+    void Add(Key_t key, Value_t value)
+    {
+        assert(key >= cursor_ && "BucketQueue keys can't go below the current window");
+
+        buckets_[(key >> widthShift_) & bucketMask_].Add(Entry{ key, std::move(value) });
+        ++count_;
+    }
+
+    //------------------------------------------------------------------------------
+    Entry RemoveTop()
+    {
+        assert(count_);
+
+        const Key_t width = (Key_t)1 << widthShift_;
+        for (uint step = 0;; ++step)
+        {
+            if (step > bucketMask_)
+            {
+                // A full round without a key in its window, everything is far ahead
+                cursor_ = FindMinKey() >> widthShift_ << widthShift_;
+                step = 0;
+            }
+
+            Array<Entry>& bucket = buckets_[(cursor_ >> widthShift_) & bucketMask_];
+
+            // From the back so the removal doesn't move anything, the cursor is the lowest possible
+            // key so finding it ends the scan, with width 1 it's the first key in the window
+            uint64 best = Array<Entry>::IndexBad();
+            for (uint64 i = bucket.Count(); i-- > 0;)
+            {
+                if (bucket[i].key_ - cursor_ < width && (best == Array<Entry>::IndexBad() || bucket[i].key_ < bucket[best].key_))
+                {
+                    best = i;
+                    if (bucket[i].key_ == cursor_)
+                        break;
+                }
+            }
+
+            if (best != Array<Entry>::IndexBad())
+            {
+                Entry entry = std::move(bucket[best]);
+                bucket.RemoveSwapBack(best);
+                --count_;
+                return entry;
+            }
+
+            cursor_ += width;
+        }
+    }
+
+private:
+    Array<Array<Entry>> buckets_;
+    uint                bucketMask_;
+    uint                widthShift_;
+    Key_t               cursor_{};
+    uint64              count_{};
+
+    //------------------------------------------------------------------------------
+    Key_t FindMinKey() const
+    {
+        Key_t minKey = (Key_t)-1;
+        for (uint64 b = 0; b < buckets_.Count(); ++b)
+        {
+            for (uint64 i = 0; i < buckets_[b].Count(); ++i)
+                minKey = buckets_[b][i].key_ < minKey ? buckets_[b][i].key_ : minKey;
+        }
+        return minKey;
+    }
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "Types.h"
+#include "ps_Math.h"
+#include "Array.h"
+
+#include <cassert>
+#include <utility>
+
+/*
+Same bitfield per 64 slots as SparseArray but every block keeps its own bucket
+of items instead of one global items array, inserting only shifts inside the
+bucket. The global ranks which SparseArray keeps in bitSums_ are in a Fenwick
+tree over the block popcounts so updating them is O(log blocks).
+
+bitField        bucket          fenwick (1 based, node i sums blocks (i - lowbit(i), i])
+0x000000005     a[0] a[2]       [1] = 2
+0x000018001     a[64] a[79]...  [2] = 2 + 3
+0x800000000     a[191]          [3] = 1
+*/
+
+//-----------------------------------------------------------------------------
+template<class Item_t>
+class BucketSparseArray
+{
+public:
+    using BitField_t = uint64;
+
+    //-----------------------------------------------------------------------------
+    BucketSparseArray()
+        : BucketSparseArray(hs::GetDefaultAllocator())
+    {
+    }
+
+    //-----------------------------------------------------------------------------
+    explicit BucketSparseArray(hs::Allocator* allocator)
+        : allocator_(allocator)
+        , bitFields_(allocator)
+        , buckets_(allocator)
+        , fenwick_(allocator)
+    {
+        fenwick_.Add(0); // Node 0 is unused, the tree is 1 based
+    }
+
+    //-----------------------------------------------------------------------------
+    uint Count() const
+    {
+        return count_;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool Contains(uint idx) const
+    {
+        uint iMain = idx >> 6;
+        uint iBits = idx & 63;
+
+        if (iMain >= bitFields_.Count())
+            return false;
+
+        return (bitFields_[iMain] & ((BitField_t)1 << iBits)) != 0;
+    }
+
+    //-----------------------------------------------------------------------------
+    // Returns nullptr when the index is not present
+    Item_t* Find(uint idx)
+    {
+        uint iMain = idx >> 6;
+        uint iBits = idx & 63;
+
+        if (iMain >= bitFields_.Count())
+            return nullptr;
+
+        BitField_t bitfield = bitFields_[iMain];
+        BitField_t mask = ((BitField_t)1 << iBits);
+        if ((bitfield & mask) == 0)
+            return nullptr;
+
+        return &buckets_[iMain][PopCount64(bitfield & (mask - 1))];
+    }
+
+    //-----------------------------------------------------------------------------
+    Item_t& operator[](uint idx)
+    {
+        Item_t* item = Find(idx);
+        assert(item);
+        return *item;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool Insert(uint idx, Item_t newItem)
+    {
+        uint iMain = idx >> 6;
+        uint iBits = idx & 63;
+
+        if (iMain >= bitFields_.Count())
+            Grow(iMain + 1);
+
+        BitField_t* bitfield = &bitFields_[iMain];
+        BitField_t mask = ((BitField_t)1 << iBits);
+
+        // Already present
+        if ((*bitfield & mask) != 0)
+            return false;
+
+        buckets_[iMain].Insert(PopCount64(*bitfield & (mask - 1)), std::move(newItem));
+        *bitfield |= mask;
+
+        FenwickAdd(iMain, 1);
+        ++count_;
+
+        return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool Remove(uint idx)
+    {
+        uint iMain = idx >> 6;
+        uint iBits = idx & 63;
+
+        if (iMain >= bitFields_.Count())
+            return false;
+
+        BitField_t* bitfield = &bitFields_[iMain];
+        BitField_t mask = ((BitField_t)1 << iBits);
+        if ((*bitfield & mask) == 0)
+            return false;
+
+        *bitfield &= ~mask;
+        buckets_[iMain].Remove(PopCount64(*bitfield & (mask - 1)));
+
+        FenwickAdd(iMain, (uint)-1);
+        --count_;
+
+        return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    // Number of present elements with index lower than idx, O(log blocks)
+    uint Rank(uint idx) const
+    {
+        uint iMain = idx >> 6;
+        uint iBits = idx & 63;
+
+        if (iMain >= bitFields_.Count())
+            return count_;
+
+        return FenwickPrefix(iMain) + PopCount64(bitFields_[iMain] & (((BitField_t)1 << iBits) - 1));
+    }
+
+    //-----------------------------------------------------------------------------
+    // Index of the element with the given rank (0 is the lowest index), O(log blocks)
+    uint Select(uint rank) const
+    {
+        assert(rank < count_);
+
+        // Descend the tree looking for the last block whose prefix is <= rank
+        uint block = 0;
+        uint step = 1;
+        while ((step << 1) < fenwick_.Count())
+            step <<= 1;
+
+        for (; step; step >>= 1)
+        {
+            if (block + step < fenwick_.Count() && fenwick_[block + step] <= rank)
+            {
+                block += step;
+                rank -= fenwick_[block];
+            }
+        }
+
+        // block is now the 0 based index of the block holding the element
+        BitField_t bits = bitFields_[block];
+        for (uint i = 0; i < rank; ++i)
+            bits &= bits - 1;
+
+        return (block << 6) + CountTrailingZeros64(bits);
+    }
+
+private:
+    hs::Allocator*                  allocator_;
+    hs::Array<BitField_t>           bitFields_;
+    hs::Array<hs::Array<Item_t>>    buckets_;
+    hs::Array<uint>                 fenwick_;
+    uint                            count_{};
+
+    //-----------------------------------------------------------------------------
+    void FenwickAdd(uint block, uint delta)
+    {
+        for (uint64 i = block + 1; i < fenwick_.Count(); i += i & (0 - i))
+            fenwick_[i] += delta;
+    }
+
+    //-----------------------------------------------------------------------------
+    // Sum of the popcounts of blocks [0, block)
+    uint FenwickPrefix(uint block) const
+    {
+        uint sum = 0;
+        for (uint64 i = block; i > 0; i -= i & (0 - i))
+            sum += fenwick_[i];
+        return sum;
+    }
+
+    //-----------------------------------------------------------------------------
+    // Grows geometrically, the tree is rebuilt in linear time so it's amortized O(1)
+    void Grow(uint64 blockCount)
+    {
+        const uint64 oldCount = bitFields_.Count();
+        const uint64 newCount = Max(blockCount, oldCount * 2);
+
+        bitFields_.Resize(newCount);
+        buckets_.Reserve(newCount);
+        for (uint64 i = oldCount; i < newCount; ++i)
+            buckets_.EmplaceBack(allocator_);
+
+        fenwick_.Resize(newCount + 1);
+        for (uint64 i = 1; i <= newCount; ++i)
+            fenwick_[i] = PopCount64(bitFields_[i - 1]);
+
+        for (uint64 i = 1; i <= newCount; ++i)
+        {
+            const uint64 parent = i + (i & (0 - i));
+            if (parent <= newCount)
+                fenwick_[parent] += fenwick_[i];
+        }
+    }
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "Types.h"
+#include "ps_Math.h"
+#include "Allocator.h"
+#include "Span.h"
+
+#include <atomic>
+#include <cassert>
+#include <new>
+#include <utility>
+
+namespace hs
+{
+//------------------------------------------------------------------------------
+// Array which many threads can append to at the same time. Each add reserves its
+// slot with a single fetch_add on the cursor, the storage is split into segments
+// doubling in size so growing never moves elements already written. When the
+// capacity was reserved up front the add is wait-free, otherwise the first thread
+// reaching a new segment allocates it (lock-free, losers of the race free theirs).
+//
+// Only adding is concurrent. Reading the elements, Reserve, Clear and destruction
+// expect the producers to be finished (e.g. joined). Producers allocate segments
+// from their own threads so the allocator has to be thread-safe.
+template<class T, uint FirstSegmentBits = 6>
+class ConcurrentArray
+{
+public:
+    static constexpr uint64 FIRST_SEGMENT_SIZE = (uint64)1 << FirstSegmentBits;
+    static constexpr uint MAX_SEGMENTS = 64 - FirstSegmentBits;
+
+    //------------------------------------------------------------------------------
+    ConcurrentArray()
+        : ConcurrentArray(GetDefaultAllocator())
+    {
+    }
+
+    //------------------------------------------------------------------------------
+    explicit ConcurrentArray(Allocator* allocator)
+        : allocator_(allocator)
+    {
+        hs_assert(allocator_);
+        hs_assert(allocator_->IsThreadSafe() && "Segments are allocated from the producer threads");
+        for (uint i = 0; i < MAX_SEGMENTS; ++i)
+            segments_[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    //------------------------------------------------------------------------------
+    ~ConcurrentArray()
+    {
+        Clear();
+        for (uint i = 0; i < MAX_SEGMENTS; ++i)
+        {
+            if (T* segment = segments_[i].load(std::memory_order_relaxed))
+                allocator_->Free(segment, SegmentSize(i) * sizeof(T));
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    ConcurrentArray(const ConcurrentArray&) = delete;
+
+    //------------------------------------------------------------------------------
+    ConcurrentArray& operator=(const ConcurrentArray&) = delete;
+
+    //------------------------------------------------------------------------------
+    Allocator* GetAllocator() const
+    {
+        return allocator_;
+    }
+
+    //------------------------------------------------------------------------------
+    // Number of reserved slots, equal to the number of elements once producers finish
+    uint64 Count() const
+    {
+        return cursor_.load(std::memory_order_acquire);
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsEmpty() const
+    {
+        return Count() == 0;
+    }
+
+    //------------------------------------------------------------------------------
+    const T& operator[](uint64 index) const
+    {
+        hs_assert(index < Count());
+        return *Slot(index);
+    }
+
+    //------------------------------------------------------------------------------
+    T& operator[](uint64 index)
+    {
+        hs_assert(index < Count());
+        return *Slot(index);
+    }
+
+    //------------------------------------------------------------------------------
+    // Safe to call from many threads at once, returns index of the new element
+    template<class ...ArgsT>
+    uint64 EmplaceAtomic(ArgsT&&... args)
+    {
+        const uint64 index = cursor_.fetch_add(1, std::memory_order_relaxed);
+        const uint segmentIndex = SegmentIndex(index);
+        T* segment = EnsureSegment(segmentIndex);
+        new(segment + (index - SegmentBegin(segmentIndex))) T(std::forward<ArgsT>(args)...);
+        return index;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 AddAtomic(const T& item)
+    {
+        return EmplaceAtomic(item);
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 AddAtomic(T&& item)
+    {
+        return EmplaceAtomic(std::move(item));
+    }
+
+    //------------------------------------------------------------------------------
+    // Allocates segments up front so adds up to the capacity never allocate
+    void Reserve(uint64 capacity)
+    {
+        if (!capacity)
+            return;
+
+        const uint last = SegmentIndex(capacity - 1);
+        for (uint i = 0; i <= last; ++i)
+            EnsureSegment(i);
+    }
+
+    //------------------------------------------------------------------------------
+    // Destroys the elements but keeps the segments for reuse
+    void Clear()
+    {
+        const uint64 count = cursor_.load(std::memory_order_acquire);
+        for (uint64 i = 0; i < count; ++i)
+            Slot(i)->~T();
+        cursor_.store(0, std::memory_order_release);
+    }
+
+    //------------------------------------------------------------------------------
+    // Number of segments holding at least one element
+    uint SegmentCount() const
+    {
+        const uint64 count = Count();
+        return count ? SegmentIndex(count - 1) + 1 : 0;
+    }
+
+    //------------------------------------------------------------------------------
+    // Contiguous part of the array, all segments but the last one are full
+    Span<T> GetSegment(uint segmentIndex)
+    {
+        hs_assert(segmentIndex < SegmentCount());
+        const uint64 begin = SegmentBegin(segmentIndex);
+        const uint64 size = SegmentSize(segmentIndex);
+        const uint64 count = Count() - begin < size ? Count() - begin : size;
+        return Span<T>(segments_[segmentIndex].load(std::memory_order_acquire), count);
+    }
+
+private:
+    // Own cache line so producers hammering the cursor don't invalidate the segment table
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64> cursor_{};
+    alignas(CACHE_LINE_SIZE) std::atomic<T*> segments_[MAX_SEGMENTS];
+    Allocator* allocator_;
+
+    //------------------------------------------------------------------------------
+    // Segment 0 holds the first FIRST_SEGMENT_SIZE elements, segment i > 0 holds
+    // [FIRST_SEGMENT_SIZE << (i - 1), FIRST_SEGMENT_SIZE << i)
+    static uint SegmentIndex(uint64 index)
+    {
+        const uint64 scaled = index >> FirstSegmentBits;
+        return scaled ? Log2Floor64(scaled) + 1 : 0;
+    }
+
+    //------------------------------------------------------------------------------
+    static uint64 SegmentBegin(uint segmentIndex)
+    {
+        return segmentIndex ? FIRST_SEGMENT_SIZE << (segmentIndex - 1) : 0;
+    }
+
+    //------------------------------------------------------------------------------
+    static uint64 SegmentSize(uint segmentIndex)
+    {
+        return segmentIndex ? FIRST_SEGMENT_SIZE << (segmentIndex - 1) : FIRST_SEGMENT_SIZE;
+    }
+
+    //------------------------------------------------------------------------------
+    T* EnsureSegment(uint segmentIndex)
+    {
+        hs_assert(segmentIndex < MAX_SEGMENTS);
+
+        T* segment = segments_[segmentIndex].load(std::memory_order_acquire);
+        if (segment)
+            return segment;
+
+        const uint64 bytes = SegmentSize(segmentIndex) * sizeof(T);
+        T* newSegment = (T*)allocator_->Allocate(bytes, Max<uint64>(alignof(T), CACHE_LINE_SIZE));
+        hs_assert(IsAligned(newSegment, Max<uint64>(alignof(T), CACHE_LINE_SIZE)) && "Allocator doesn't honor the alignment");
+        if (segments_[segmentIndex].compare_exchange_strong(segment, newSegment, std::memory_order_acq_rel, std::memory_order_acquire))
+            return newSegment;
+
+        // Other thread was faster, segment now holds its allocation
+        allocator_->Free(newSegment, bytes);
+        return segment;
+    }
+
+    //------------------------------------------------------------------------------
+    T* Slot(uint64 index) const
+    {
+        const uint segmentIndex = SegmentIndex(index);
+        T* segment = segments_[segmentIndex].load(std::memory_order_acquire);
+        hs_assert(segment);
+        return segment + (index - SegmentBegin(segmentIndex));
+    }
+};
+
+}
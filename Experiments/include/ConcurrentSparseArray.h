@@ -0,0 +1,269 @@
+#pragma once
+
+#include "Types.h"
+#include "Allocator.h"
+#include "Array.h"
+#include "SparseArray.h"
+
+#include <atomic>
+#include <cassert>
+#include <new>
+#include <thread>
+#include <utility>
+
+/*
+SparseArray for many concurrent readers and a single writer. Readers look up an
+immutable snapshot without taking locks, the writer changes its own working copy
+and publishes it as a new snapshot (read-copy-update).
+
+Old snapshots are freed with epochs: a reader entering stores the global epoch
+into its slot, the writer retires the replaced snapshot with the epoch current at
+the time of the swap and frees it once no reader slot holds an epoch that old.
+
+Publishing copies the whole array, batch the writes between publishes.
+*/
+
+//-----------------------------------------------------------------------------
+template<class Item_t>
+class ConcurrentSparseArray
+{
+public:
+    using Snapshot_t = SparseArray<Item_t>;
+
+    // Readers registered at the same time, more block in the Reader constructor
+    static constexpr uint MAX_READERS = 64;
+
+    //-----------------------------------------------------------------------------
+    // Reader registration of one thread, owns a slot for announcing its epoch
+    class Reader
+    {
+    public:
+        //-----------------------------------------------------------------------------
+        explicit Reader(ConcurrentSparseArray& array)
+            : array_(array)
+            , slot_(array.AcquireSlot())
+        {
+        }
+
+        //-----------------------------------------------------------------------------
+        ~Reader()
+        {
+            assert(array_.slots_[slot_].epoch_.load(std::memory_order_relaxed) == 0 && "Reader destroyed inside of a read");
+            array_.slots_[slot_].used_.store(false, std::memory_order_release);
+        }
+
+        //-----------------------------------------------------------------------------
+        Reader(const Reader&) = delete;
+
+        //-----------------------------------------------------------------------------
+        Reader& operator=(const Reader&) = delete;
+
+        //-----------------------------------------------------------------------------
+        // The snapshot stays valid until Exit
+        const Snapshot_t& Enter()
+        {
+            std::atomic<uint64>& epoch = array_.slots_[slot_].epoch_;
+            assert(epoch.load(std::memory_order_relaxed) == 0 && "Nested reads are not supported");
+
+            epoch.store(array_.epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            return *array_.current_.load(std::memory_order_seq_cst);
+        }
+
+        //-----------------------------------------------------------------------------
+        void Exit()
+        {
+            array_.slots_[slot_].epoch_.store(0, std::memory_order_release);
+        }
+
+    private:
+        ConcurrentSparseArray& array_;
+        uint slot_;
+    };
+
+    //-----------------------------------------------------------------------------
+    // Enters on construction and exits on destruction
+    class ReadScope
+    {
+    public:
+        //-----------------------------------------------------------------------------
+        explicit ReadScope(Reader& reader)
+            : reader_(reader)
+            , snapshot_(reader.Enter())
+        {
+        }
+
+        //-----------------------------------------------------------------------------
+        ~ReadScope()
+        {
+            reader_.Exit();
+        }
+
+        //-----------------------------------------------------------------------------
+        ReadScope(const ReadScope&) = delete;
+
+        //-----------------------------------------------------------------------------
+        ReadScope& operator=(const ReadScope&) = delete;
+
+        //-----------------------------------------------------------------------------
+        const Snapshot_t* operator->() const
+        {
+            return &snapshot_;
+        }
+
+        //-----------------------------------------------------------------------------
+        const Snapshot_t& operator*() const
+        {
+            return snapshot_;
+        }
+
+    private:
+        Reader& reader_;
+        const Snapshot_t& snapshot_;
+    };
+
+    //-----------------------------------------------------------------------------
+    ConcurrentSparseArray()
+        : ConcurrentSparseArray(hs::GetDefaultAllocator())
+    {
+    }
+
+    //-----------------------------------------------------------------------------
+    explicit ConcurrentSparseArray(hs::Allocator* allocator)
+        : allocator_(allocator)
+        , retired_(allocator)
+    {
+        current_.store(NewSnapshot(), std::memory_order_relaxed);
+    }
+
+    //-----------------------------------------------------------------------------
+    // Expects all readers to be gone
+    ~ConcurrentSparseArray()
+    {
+        for (uint i = 0; i < MAX_READERS; ++i)
+            assert(!slots_[i].used_.load(std::memory_order_relaxed) && "Reader outlives the array");
+
+        for (const Retired& retired : retired_)
+            DeleteSnapshot(retired.snapshot_);
+        DeleteSnapshot(current_.load(std::memory_order_relaxed));
+    }
+
+    //-----------------------------------------------------------------------------
+    ConcurrentSparseArray(const ConcurrentSparseArray&) = delete;
+
+    //-----------------------------------------------------------------------------
+    ConcurrentSparseArray& operator=(const ConcurrentSparseArray&) = delete;
+
+    //-----------------------------------------------------------------------------
+    // Writer side, changes only the working copy which readers don't see until Publish
+    bool Insert(uint idx, Item_t newItem)
+    {
+        return working_.Insert(idx, std::move(newItem));
+    }
+
+    //-----------------------------------------------------------------------------
+    bool Remove(uint idx)
+    {
+        return working_.Remove(idx);
+    }
+
+    //-----------------------------------------------------------------------------
+    Snapshot_t& GetWorkingCopy()
+    {
+        return working_;
+    }
+
+    //-----------------------------------------------------------------------------
+    // Makes the working copy visible to readers and frees snapshots no reader uses
+    void Publish()
+    {
+        Snapshot_t* snapshot = NewSnapshot();
+        snapshot->Merge(working_); // Copy in one linear pass
+
+        Snapshot_t* old = current_.exchange(snapshot, std::memory_order_seq_cst);
+        const uint64 epoch = epoch_.fetch_add(1, std::memory_order_seq_cst);
+        retired_.Add(Retired{ old, epoch });
+
+        Reclaim();
+    }
+
+    //-----------------------------------------------------------------------------
+    // Number of replaced snapshots still waiting for readers
+    uint64 GetRetiredCount() const
+    {
+        return retired_.Count();
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) ReaderSlot
+    {
+        // Epoch the reader entered with, 0 when not reading
+        std::atomic<uint64> epoch_{};
+        std::atomic<bool> used_{};
+    };
+
+    struct Retired
+    {
+        Snapshot_t* snapshot_;
+        uint64 epoch_;
+    };
+
+    ReaderSlot                  slots_[MAX_READERS];
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64> epoch_{ 1 };
+    std::atomic<Snapshot_t*>    current_{};
+    hs::Allocator*              allocator_;
+    Snapshot_t                  working_;
+    hs::Array<Retired>          retired_;
+
+    //-----------------------------------------------------------------------------
+    // With all slots taken waits for a reader to be destroyed, a shared slot would let
+    // the first of the two readers to exit hide the other one from Reclaim
+    uint AcquireSlot()
+    {
+        while (true)
+        {
+            for (uint i = 0; i < MAX_READERS; ++i)
+            {
+                bool expected = false;
+                if (slots_[i].used_.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                    return i;
+            }
+
+            std::this_thread::yield();
+        }
+    }
+
+    //-----------------------------------------------------------------------------
+    void Reclaim()
+    {
+        // Readers which entered before a snapshot was retired hold epoch <= its retire epoch
+        uint64 oldestReader = (uint64)-1;
+        for (uint i = 0; i < MAX_READERS; ++i)
+        {
+            const uint64 epoch = slots_[i].epoch_.load(std::memory_order_seq_cst);
+            if (epoch && epoch < oldestReader)
+                oldestReader = epoch;
+        }
+
+        retired_.RemoveIf([this, oldestReader](const Retired& r)
+        {
+            if (r.epoch_ >= oldestReader)
+                return false;
+
+            DeleteSnapshot(r.snapshot_);
+            return true;
+        });
+    }
+
+    //-----------------------------------------------------------------------------
+    Snapshot_t* NewSnapshot()
+    {
+        return new(allocator_->Allocate(sizeof(Snapshot_t), alignof(Snapshot_t))) Snapshot_t();
+    }
+
+    //-----------------------------------------------------------------------------
+    void DeleteSnapshot(Snapshot_t* snapshot)
+    {
+        snapshot->~Snapshot_t();
+        allocator_->Free(snapshot, sizeof(Snapshot_t));
+    }
+};
@@ -2,7 +2,10 @@
 
 #include "Types.h"
 #include "Array.h"
+#include "InlineArray.h"
+#include "StableArray.h"
 #include "Span.h"
+#include "SparseSet.h"
 
 #include <cstdio>
 #include <tuple>
@@ -17,6 +20,10 @@ namespace archetypeECS
 
 static constexpr uint64 COMPONENT_COUNT = 100;
 static constexpr uint COMPONENT_MASK_SIZE = COMPONENT_COUNT << 6;
+// Archetypes with up to this many components keep their type list without allocating
+static constexpr uint64 INLINE_TYPE_SIZE = 8;
+// Columns start on a cache line so they can be read with aligned SIMD loads
+static constexpr uint COLUMN_ALIGNMENT = CACHE_LINE_SIZE;
 
 using ArchetypeType_t = uint64[COMPONENT_MASK_SIZE];
 
@@ -111,20 +118,23 @@ class EcsWorld;
 class Archetype // Table?
 {
 public:
-    using Type_t = Array<uint>;
+    using Type_t = InlineArray<uint, INLINE_TYPE_SIZE>;
 
     //------------------------------------------------------------------------------
-    Archetype(EcsWorld* world, const Type_t& type)
+    Archetype(EcsWorld* world, const Type_t& type, Allocator* allocator)
         : world_(world)
+        , allocator_(allocator)
+        , type_(allocator)
+        , columns_(allocator)
     {
         type_ = type;
         rowCapacity_ = 8;
 
         for (int i = 0; i < type_.Count(); ++i)
         {
-            // TODO alignment
             const TypeDetails* details = TypeInfoId::GetDetails(type_[i]);
-            Column_t column = malloc(rowCapacity_ * details->size_);
+            Column_t column = allocator_->Allocate(rowCapacity_ * details->size_, Max(details->alignment_, COLUMN_ALIGNMENT));
+            hs_assert(IsAligned(column, Max(details->alignment_, COLUMN_ALIGNMENT)) && "Allocator doesn't honor the alignment");
             columns_.Add(column);
         }
     }
@@ -132,9 +142,10 @@ public:
     //------------------------------------------------------------------------------
     ~Archetype()
     {
-        for (int i = 0; i < type_.Count(); ++i)
+        for (int i = 0; i < columns_.Count(); ++i)
         {
-            free(columns_[i]);
+            const TypeDetails* details = TypeInfoId::GetDetails(type_[i]);
+            allocator_->Free(columns_[i], rowCapacity_ * details->size_);
         }
     }
 
@@ -248,25 +259,13 @@ public:
     void RemoveRow(uint row);
 
     //------------------------------------------------------------------------------
-    int TryGetIterators(const Type_t& canonicalType, Span<const uint> permutation, void** arr) const
+    // Typed view of all rows of the component column, TComponent can be const
+    template<class TComponent>
+    Span<TComponent> GetColumn()
     {
-        if (canonicalType.Count() > type_.Count())
-            return 0;
-
-        int colI = 0;
-        for (int i = 0; i < type_.Count() && colI < permutation.Count(); ++i)
-        {
-            if (canonicalType[colI] == type_[i])
-            {
-                auto finalIdx = permutation[colI++];
-                arr[finalIdx] = columns_[i];
-            }
-        }
-
-        if (colI != permutation.Count())
-            return 0;
-
-        return rowCount_;
+        const uint componentIdx = FindComponent<TComponent>();
+        hs_assert(componentIdx != ID_BAD);
+        return Span<TComponent>(static_cast<TComponent*>(columns_[componentIdx]), rowCount_);
     }
 
     //------------------------------------------------------------------------------
@@ -288,6 +287,7 @@ public:
 
 private:
     EcsWorld* world_;
+    Allocator* allocator_;
     Type_t type_;
     Array<Column_t> columns_;
     uint rowCount_{};
@@ -305,14 +305,15 @@ private:
     {
         if (rowCount_ == rowCapacity_)
         {
+            const uint oldCapacity = rowCapacity_;
             rowCapacity_ *= 2;
             for (int i = 0; i < columns_.Count(); ++i)
             {
-                // TODO alignment
                 const TypeDetails* details = TypeInfoId::GetDetails(type_[i]);
-                Column_t newColumn = malloc(rowCapacity_ * details->size_);
+                Column_t newColumn = allocator_->Allocate(rowCapacity_ * details->size_, Max(details->alignment_, COLUMN_ALIGNMENT));
+                hs_assert(IsAligned(newColumn, Max(details->alignment_, COLUMN_ALIGNMENT)) && "Allocator doesn't honor the alignment");
                 memcpy(newColumn, columns_[i], rowCount_ * details->size_);
-                free(columns_[i]);
+                allocator_->Free(columns_[i], oldCapacity * details->size_);
                 columns_[i] = newColumn;
             }
         }
@@ -349,6 +350,16 @@ private:
     }
 };
 
+}
+
+//------------------------------------------------------------------------------
+// Only owns memory through pointers
+template<>
+struct IsTriviallyRelocatable<archetypeECS::Archetype> : std::true_type {};
+
+namespace archetypeECS
+{
+
 //------------------------------------------------------------------------------
 // Class that has all the types and entities
 class EcsWorld
@@ -357,59 +368,38 @@ class EcsWorld
 
 public:
     //------------------------------------------------------------------------------
-    EcsWorld()
+    explicit EcsWorld(Allocator* allocator = GetDefaultAllocator())
+        : allocator_(allocator)
+        , entities_(allocator)
+        , archetypes_(allocator)
     {
-        Archetype emptyArchetype(this, { 0 });
+        Archetype emptyArchetype(this, { 0 }, allocator_);
         archetypes_.Add(std::move(emptyArchetype));
     }
 
     //------------------------------------------------------------------------------
+    // Ids of deleted entities are reused with a new generation, old ids stop being valid
     Entity_t CreteEntity()
     {
-        Entity_t id{};
-
-        if (denseUsedCount_ == dense_.Count())
-        {
-            id = denseUsedCount_;
-            dense_.Add(id);
-            sparse_.Add(id);
-        }
-        else
-        {
-            hs_assert(denseUsedCount_ < dense_.Count());
-            id = dense_[denseUsedCount_];
-            sparse_[id] = denseUsedCount_;
-        }
-        ++denseUsedCount_;
-
-        EntityRecord record;
-        record.archetype_= 0;
-        record.rowIndex_ = archetypes_[0].AddEntity(id);
-
-        records_.Add(record);
+        const Entity_t id = entities_.Create(EntityRecord{ 0, 0 });
+        entities_[id].rowIndex_ = archetypes_[0].AddEntity(id);
 
         return id;
     }
 
     //------------------------------------------------------------------------------
-    void DeleteEntity(Entity_t entity)
+    bool IsAlive(Entity_t entity) const
     {
-        hs_assert(denseUsedCount_ > 0);
-
-        auto denseIdx = sparse_[entity];
-        auto lastDense = denseUsedCount_ - 1;
-        hs_assert(denseIdx <= denseUsedCount_);
+        return entities_.Contains(entity);
+    }
 
-        const auto& record = records_[denseIdx];
+    //------------------------------------------------------------------------------
+    void DeleteEntity(Entity_t entity)
+    {
+        const EntityRecord& record = entities_[entity];
         archetypes_[record.archetype_].RemoveRow(record.rowIndex_);
 
-        if (denseIdx < lastDense)
-        {
-            SwapEntity(denseIdx, lastDense);
-        }
-
-        // Remove last entity
-        --denseUsedCount_;
+        entities_.Remove(entity);
     }
 
     //------------------------------------------------------------------------------
@@ -417,8 +407,7 @@ public:
     void SetComponents(Entity_t entity, const TComponent&... components)
     {
         // Find entity
-        auto dense = sparse_[entity];
-        EntityRecord& record = records_[dense];
+        EntityRecord& record = entities_[entity];
         Archetype* originalArch = &archetypes_[record.archetype_];
 
         if (originalArch->HasComponents<TComponent...>())
@@ -427,32 +416,32 @@ public:
         }
         else
         {
-            // TODO get rid of this allocation
             auto type = originalArch->GetType();
             AddComponentsToType<TComponent...>(type);
 
             uint archetypeIdx = ID_BAD;
+            Archetype* newArch = nullptr;
 
             for (int i = 0; i < archetypes_.Count(); ++i)
             {
                 if (archetypes_[i].IsType(type))
                 {
                     archetypeIdx = i;
+                    newArch = &archetypes_[i];
                     break;
                 }
             }
 
+            // Archetypes never move so originalArch stays valid
             if (archetypeIdx == ID_BAD)
             {
-                Archetype newArchetype(this, type);
-                archetypes_.Add(std::move(newArchetype));
-                archetypeIdx = archetypes_.Count() - 1;
+                archetypeIdx = archetypes_.Count();
+                newArch = &archetypes_.Add(Archetype(this, type, allocator_));
             }
 
-            hs_assert(archetypeIdx != ID_BAD);
+            hs_assert(newArch);
 
             // Copy components one by one from old to the new originalArch
-            Archetype* newArch = &archetypes_[archetypeIdx];
 
             EntityRecord newRecord;
             newRecord.archetype_ = archetypeIdx;
@@ -476,10 +465,9 @@ public:
     }
 
     //------------------------------------------------------------------------------
-    void GetEntities(uint*& begin, uint& count)
+    Span<const Entity_t> GetEntities() const
     {
-        begin = dense_.Data();
-        count = denseUsedCount_;
+        return entities_.Keys();
     }
 
     //------------------------------------------------------------------------------
@@ -492,30 +480,15 @@ public:
         template<class TFun>
         void Each(TFun fun)
         {
-            static constexpr int COMP_COUNT = sizeof...(TComponents);
-            auto seq = std::make_index_sequence<COMP_COUNT>();
-
-            Archetype::Type_t type{ TypeInfo<TComponents>::TypeId()... };
-            Archetype::Type_t canonicalType = type;
-            std::sort(canonicalType.begin(), canonicalType.end());
-
-            uint permutation[COMP_COUNT];
-            for (int i = 0; i < COMP_COUNT; ++i)
-            {
-                permutation[i] = type.IndexOf(canonicalType[i]);
-            }
-
             for (int archI = 0; archI < world_->archetypes_.Count(); ++archI)
             {
-                void* arr[COMP_COUNT]{};
-                if (int rowCount = world_->archetypes_[archI].TryGetIterators(canonicalType, MakeSpan(permutation), arr);
-                    rowCount)
-                {
-                    for (int rowI = 0; rowI < rowCount; ++rowI)
-                    {
-                        CallHelper(arr, rowI, fun, seq);
-                    }
-                }
+                Archetype& archetype = world_->archetypes_[archI];
+                if (!archetype.HasComponents<TComponents...>())
+                    continue;
+
+                // Columns in the order of the function parameters
+                std::tuple<Span<TComponents>...> columns{ archetype.GetColumn<TComponents>()... };
+                EachRow(columns, fun, std::index_sequence_for<TComponents...>());
             }
         }
 
@@ -523,12 +496,13 @@ public:
         EcsWorld* world_;
 
         //------------------------------------------------------------------------------
-        template<class TFun, unsigned long... Seq>
-        void CallHelper(void** arr, int row, TFun fun, std::index_sequence<Seq...>)
+        template<class TFun, size_t... Seq>
+        static void EachRow(const std::tuple<Span<TComponents>...>& columns, TFun& fun, std::index_sequence<Seq...>)
         {
-            fun(((TComponents*)arr[Seq])[row]...);
+            const uint64 rowCount = std::get<0>(columns).Count();
+            for (uint64 row = 0; row < rowCount; ++row)
+                fun(std::get<Seq>(columns)[row]...);
         }
-
     };
 
 private:
@@ -538,21 +512,9 @@ private:
         uint rowIndex_;
     };
 
-    Array<Entity_t>     sparse_;
-    Array<uint>         dense_;
-    Array<EntityRecord> records_;
-    Array<Archetype>    archetypes_;
-    uint                denseUsedCount_{};
-
-    //------------------------------------------------------------------------------
-    void SwapEntity(uint denseIdxA, uint denseIdxB)
-    {
-        Swap(dense_[denseIdxA], dense_[denseIdxB]);
-        Swap(records_[denseIdxA], records_[denseIdxB]);
-
-        sparse_[dense_[denseIdxA]] = denseIdxA;
-        sparse_[dense_[denseIdxB]] = denseIdxB;
-    }
+    Allocator*                  allocator_;
+    SparseSet<EntityRecord>     entities_;
+    StableArray<Archetype>      archetypes_;
 
     //------------------------------------------------------------------------------
     template<class TComponent>
@@ -591,8 +553,7 @@ private:
     //------------------------------------------------------------------------------
     void UpdateRecord(Entity_t eid, uint rowIdx)
     {
-        auto denseIdx = sparse_[eid];
-        records_[denseIdx].rowIndex_ = rowIdx;
+        entities_[eid].rowIndex_ = rowIdx;
     }
 };
 
@@ -1,94 +1,346 @@
 #pragma once
 
 #include "Array.h"
+#include "Span.h"
+#include "ps_Math.h"
 
 #include <cmath>
 #include <cassert>
+#include <functional>
+#include <type_traits>
+#include <utility>
 
-using namespace hs;
+#if defined(__SSE4_1__) || defined(__AVX__)
+    #include <immintrin.h>
+#endif
 
-//------------------------------------------------------------------------------
-void Swap(int& a, int& b)
-{
-    int tmp = a;
-    a = b;
-    b = tmp;
-}
+using namespace hs;
 
 //------------------------------------------------------------------------------
+// Heap where Top is the element that compares before all others (the minimum with std::less).
+// Sifting moves a hole instead of swapping, each level costs one move instead of three.
+//
+// Arity over 2 makes a d-ary heap, fewer levels but more children compared per level.
+// The storage is then cache line aligned and starts with Arity - 1 padding elements so the
+// children of every node sit in one aligned group, with 4 or 8 ints or floats and std::less
+// or std::greater the best child is picked with SIMD (SSE4.1 for 4, AVX2 for 8).
+// The padding needs T to be default constructible.
+template<class T = int, class Compare = std::less<T>, uint Arity = 2>
 class Heap
 {
+    static_assert(Arity >= 2, "Heap needs at least two children per node");
+
+    static constexpr uint64 ROOT = Arity == 2 ? 0 : Arity - 1;
+    static constexpr uint64 ALIGNMENT = Arity == 2 || alignof(T) > CACHE_LINE_SIZE ? alignof(T) : CACHE_LINE_SIZE;
+
+    using Storage_t = Array<T, ALIGNMENT>;
+
 public:
     //------------------------------------------------------------------------------
-    size_t Count()
+    Heap()
+        : Heap(GetDefaultAllocator())
     {
-        return values_.Count();
     }
 
     //------------------------------------------------------------------------------
-    void Add(int x)
+    explicit Heap(Allocator* allocator, Compare compare = Compare())
+        : values_(allocator)
+        , compare_(std::move(compare))
     {
-        values_.Add(x);
+        ResetPadding();
+    }
 
-        size_t idx = values_.Count() - 1;
+    //------------------------------------------------------------------------------
+    // Takes the values over and heapifies them in O(n)
+    explicit Heap(Array<T>&& values, Compare compare = Compare())
+        : values_(Adopt(std::move(values)))
+        , compare_(std::move(compare))
+    {
+        Heapify();
+    }
 
-        while (idx != 0)
+    //------------------------------------------------------------------------------
+    // Copies the values and heapifies them in O(n)
+    explicit Heap(Span<const T> values, Allocator* allocator = GetDefaultAllocator(), Compare compare = Compare())
+        : values_(allocator)
+        , compare_(std::move(compare))
+    {
+        values_.Reserve(ROOT + values.Count());
+        ResetPadding();
+        values_.AddRange(values);
+        Heapify();
+    }
+
+    //------------------------------------------------------------------------------
+    size_t Count() const
+    {
+        return values_.Count() - ROOT;
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsEmpty() const
+    {
+        return Count() == 0;
+    }
+
+    //------------------------------------------------------------------------------
+    void Reserve(uint64 capacity)
+    {
+        values_.Reserve(ROOT + capacity);
+    }
+
+    //------------------------------------------------------------------------------
+    void Clear()
+    {
+        ResetPadding();
+    }
+
+    //------------------------------------------------------------------------------
+    const T& Top() const
+    {
+        assert(Count());
+        return values_[ROOT];
+    }
+
+    //------------------------------------------------------------------------------
+    void Add(T x)
+    {
+        values_.Add(std::move(x));
+
+        // The new slot becomes the hole, SiftUp fills it
+        const uint64 idx = Count() - 1;
+        if (idx != 0 && compare_(Value(idx), Value((idx - 1) / Arity)))
         {
-            size_t parent = 0;
-            if (idx & 1)
-                parent = (idx - 1) / 2;
-            else
-                parent = (idx - 2) / 2;
+            T last = std::move(Value(idx));
+            SiftUp(idx, std::move(last));
+        }
+    }
 
-            if (values_[idx] < values_[parent])
-            {
-                Swap(values_[idx], values_[parent]);
-                idx = parent;
-            }
-            else
-            {
-                break;
-            }
+    //------------------------------------------------------------------------------
+    T RemoveTop()
+    {
+        assert(Count());
+
+        T ret = std::move(Value(0));
+        if (Count() > 1)
+        {
+            T last = std::move(values_.Last());
+            values_.RemoveLast();
+            SiftDown(0, std::move(last));
         }
+        else
+        {
+            values_.RemoveLast();
+        }
+
+        return ret;
+    }
+
+    //------------------------------------------------------------------------------
+    // Add followed by RemoveTop in a single sift, x is returned right away when it would be the top
+    T PushPop(T x)
+    {
+        if (IsEmpty() || !compare_(Value(0), x))
+            return x;
+
+        T ret = std::move(Value(0));
+        SiftDown(0, std::move(x));
+        return ret;
     }
 
     //------------------------------------------------------------------------------
-    int RemoveMin()
+    // RemoveTop followed by Add in a single sift
+    T ReplaceTop(T x)
     {
-        assert(values_.Count());
+        assert(Count());
 
-        int ret = values_[0];
-        values_[0] = values_.Last();
-        values_.Remove(values_.Count() - 1);
+        T ret = std::move(Value(0));
+        SiftDown(0, std::move(x));
+        return ret;
+    }
 
-        size_t count = values_.Count();
+private:
+    Storage_t values_;
+    Compare compare_;
 
-        int idx = 0;
-        while (true)
+    //------------------------------------------------------------------------------
+    static Storage_t Adopt(Array<T>&& values)
+    {
+        if constexpr (std::is_same_v<Storage_t, Array<T>> && ROOT == 0)
         {
-            int left = 2 * idx + 1;
-            int right = 2 * idx + 2;
+            return std::move(values);
+        }
+        else
+        {
+            Storage_t storage(values.GetAllocator());
+            storage.Reserve(ROOT + values.Count());
+            storage.Resize(ROOT);
+            for (uint64 i = 0; i < values.Count(); ++i)
+                storage.Add(std::move(values[i]));
+            return storage;
+        }
+    }
 
-            int lowest = idx;
+    //------------------------------------------------------------------------------
+    // Removes all values leaving only the padding, binary heaps have none so they work
+    // with types that can't be default constructed
+    void ResetPadding()
+    {
+        if constexpr (ROOT != 0)
+            values_.Resize(ROOT);
+        else
+            values_.Clear();
+    }
 
-            if (left < count && values_[left] < values_[lowest])
-                lowest = left;
-            
-            if (right < count && values_[right] < values_[lowest])
-                lowest = right;
+    //------------------------------------------------------------------------------
+    // Indices of the sift functions don't include the padding
+    T& Value(uint64 idx)
+    {
+        return values_[ROOT + idx];
+    }
+
+    //------------------------------------------------------------------------------
+    // Floyd's bottom up construction, sifts down every parent starting from the last one
+    void Heapify()
+    {
+        const uint64 count = Count();
+        if (count < 2)
+            return;
+
+        for (uint64 i = (count - 2) / Arity + 1; i-- > 0;)
+        {
+            T x = std::move(Value(i));
+            SiftDown(i, std::move(x));
+        }
+    }
 
-            if (lowest == idx)
+    //------------------------------------------------------------------------------
+    // idx is a hole, moves parents down until x fits
+    void SiftUp(uint64 idx, T&& x)
+    {
+        while (idx != 0)
+        {
+            const uint64 parent = (idx - 1) / Arity;
+            if (!compare_(x, Value(parent)))
                 break;
 
-            Swap(values_[lowest], values_[idx]);
-            
-            idx = lowest;
+            Value(idx) = std::move(Value(parent));
+            idx = parent;
         }
 
-        return ret;
+        Value(idx) = std::move(x);
     }
 
-private:
-    Array<int> values_;
-};
+    //------------------------------------------------------------------------------
+    // idx is a hole, moves the best child up until x fits
+    void SiftDown(uint64 idx, T&& x)
+    {
+        const uint64 count = Count();
+        while (true)
+        {
+            const uint64 first = Arity * idx + 1;
+            if (first >= count)
+                break;
+
+            const uint64 child = BestChild(first, count);
+            if (!compare_(Value(child), x))
+                break;
+
+            Value(idx) = std::move(Value(child));
+            idx = child;
+        }
 
+        Value(idx) = std::move(x);
+    }
+
+    //------------------------------------------------------------------------------
+    // The child which compares before its siblings, the first one of equal children
+    uint64 BestChild(uint64 first, uint64 count)
+    {
+        if constexpr (HasSimdBestChild())
+        {
+            if (first + Arity <= count)
+            {
+                const uint best = SimdBestChild(&Value(first));
+                if (best < Arity)
+                    return first + best;
+            }
+        }
+
+        const uint64 end = first + Arity < count ? first + Arity : count;
+        uint64 best = first;
+        for (uint64 child = first + 1; child < end; ++child)
+        {
+            if (compare_(Value(child), Value(best)))
+                best = child;
+        }
+
+        return best;
+    }
+
+    //------------------------------------------------------------------------------
+    static constexpr bool HasSimdBestChild()
+    {
+        [[maybe_unused]] constexpr bool isKey = std::is_same_v<T, int> || std::is_same_v<T, float>;
+        [[maybe_unused]] constexpr bool isOrder = std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::greater<T>>;
+#if defined(__AVX2__)
+        return isKey && isOrder && (Arity == 4 || Arity == 8);
+#elif defined(__SSE4_1__) || defined(__AVX__)
+        return isKey && isOrder && Arity == 4;
+#else
+        return false;
+#endif
+    }
+
+    //------------------------------------------------------------------------------
+    // Reduces the group to its min (max) in every lane and takes the first lane equal to it.
+    // The group is aligned to its size thanks to the padding and the storage alignment.
+    // Returns Arity when no lane matched, which only happens with NaN floats, the caller
+    // then falls back to the scalar loop (NaN keys still have no meaningful order).
+    static uint SimdBestChild(const T* children)
+    {
+        constexpr bool isMin = std::is_same_v<Compare, std::less<T>>;
+        uint mask = 0;
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+        if constexpr (Arity == 4 && std::is_same_v<T, int>)
+        {
+            const __m128i v = _mm_load_si128((const __m128i*)children);
+            auto reduce = [](__m128i a, __m128i b) { return isMin ? _mm_min_epi32(a, b) : _mm_max_epi32(a, b); };
+            __m128i m = reduce(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+            m = reduce(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+            mask = (uint)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, m)));
+        }
+        else if constexpr (Arity == 4 && std::is_same_v<T, float>)
+        {
+            const __m128 v = _mm_load_ps(children);
+            auto reduce = [](__m128 a, __m128 b) { return isMin ? _mm_min_ps(a, b) : _mm_max_ps(a, b); };
+            __m128 m = reduce(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+            m = reduce(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+            mask = (uint)_mm_movemask_ps(_mm_cmpeq_ps(v, m));
+        }
+#endif
+#if defined(__AVX2__)
+        if constexpr (Arity == 8 && std::is_same_v<T, int>)
+        {
+            const __m256i v = _mm256_load_si256((const __m256i*)children);
+            auto reduce = [](__m256i a, __m256i b) { return isMin ? _mm256_min_epi32(a, b) : _mm256_max_epi32(a, b); };
+            __m256i m = reduce(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+            m = reduce(m, _mm256_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+            m = reduce(m, _mm256_permute2x128_si256(m, m, 1));
+            mask = (uint)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, m)));
+        }
+        else if constexpr (Arity == 8 && std::is_same_v<T, float>)
+        {
+            const __m256 v = _mm256_load_ps(children);
+            auto reduce = [](__m256 a, __m256 b) { return isMin ? _mm256_min_ps(a, b) : _mm256_max_ps(a, b); };
+            __m256 m = reduce(v, _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1)));
+            m = reduce(m, _mm256_permute_ps(m, _MM_SHUFFLE(1, 0, 3, 2)));
+            m = reduce(m, _mm256_permute2f128_ps(m, m, 1));
+            mask = (uint)_mm256_movemask_ps(_mm256_cmp_ps(v, m, _CMP_EQ_OQ));
+        }
+#endif
+
+        return mask ? (uint)CountTrailingZeros64(mask) : Arity;
+    }
+};
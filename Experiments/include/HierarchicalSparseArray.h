@@ -0,0 +1,356 @@
+#pragma once
+
+#include "Types.h"
+#include "ps_Math.h"
+#include "Array.h"
+
+#include <cassert>
+#include <new>
+#include <utility>
+
+/*
+SparseArray sized to the highest index needs 12 bytes of support per 64 slots,
+an element at index 2^31 costs ~400MB. Here the index space is a 64-ary tree of
+bitmaps and only populated regions exist:
+
+index bits      31..18                  17..12              11..6 / 5..0
+level           root                    group               block
+storage         bitmap + bit sums,      64 block pointers   SparseArray of 4096 slots,
+                compact group pointers                      64 bitfields + bit sums + items
+
+Lookup is three popcount ranks and two pointer hops, memory is proportional to
+the number of populated blocks (plus at most 3KB for the root).
+*/
+
+//-----------------------------------------------------------------------------
+template<class Item_t>
+class HierarchicalSparseArray
+{
+public:
+    using BitField_t = uint64;
+
+    static constexpr uint BLOCK_BITS = 12;
+    static constexpr uint GROUP_BITS = BLOCK_BITS + 6;
+
+    //-----------------------------------------------------------------------------
+    HierarchicalSparseArray()
+        : HierarchicalSparseArray(hs::GetDefaultAllocator())
+    {
+    }
+
+    //-----------------------------------------------------------------------------
+    explicit HierarchicalSparseArray(hs::Allocator* allocator)
+        : allocator_(allocator)
+        , rootBits_(allocator)
+        , rootSums_(allocator)
+        , groups_(allocator)
+    {
+    }
+
+    //-----------------------------------------------------------------------------
+    ~HierarchicalSparseArray()
+    {
+        for (Group* group : groups_)
+        {
+            for (uint i = 0; i < 64; ++i)
+            {
+                if (group->blocks_[i])
+                    Delete(group->blocks_[i]);
+            }
+            Delete(group);
+        }
+    }
+
+    //-----------------------------------------------------------------------------
+    HierarchicalSparseArray(const HierarchicalSparseArray&) = delete;
+
+    //-----------------------------------------------------------------------------
+    HierarchicalSparseArray& operator=(const HierarchicalSparseArray&) = delete;
+
+    //-----------------------------------------------------------------------------
+    uint Count() const
+    {
+        return count_;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool Contains(uint idx) const
+    {
+        const Block* block = FindBlock(idx);
+        return block && (block->bits_[(idx >> 6) & 63] & ((BitField_t)1 << (idx & 63))) != 0;
+    }
+
+    //-----------------------------------------------------------------------------
+    // Returns nullptr when the index is not present
+    Item_t* Find(uint idx)
+    {
+        Block* block = FindBlock(idx);
+        if (!block)
+            return nullptr;
+
+        return block->Find(idx);
+    }
+
+    //-----------------------------------------------------------------------------
+    Item_t& operator[](uint idx)
+    {
+        Item_t* item = Find(idx);
+        assert(item);
+        return *item;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool Insert(uint idx, Item_t newItem)
+    {
+        Group* group = FindGroup(idx);
+        if (!group)
+            group = AddGroup(idx);
+
+        Block*& block = group->blocks_[(idx >> BLOCK_BITS) & 63];
+        if (!block)
+        {
+            block = New<Block>(allocator_);
+            group->mask_ |= (BitField_t)1 << ((idx >> BLOCK_BITS) & 63);
+        }
+
+        if (!block->Insert(idx, std::move(newItem)))
+            return false;
+
+        ++count_;
+        return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    // Frees blocks and groups which become empty so the memory follows the content
+    bool Remove(uint idx)
+    {
+        Group* group = FindGroup(idx);
+        if (!group)
+            return false;
+
+        const uint blockIdx = (idx >> BLOCK_BITS) & 63;
+        Block*& block = group->blocks_[blockIdx];
+        if (!block || !block->Remove(idx))
+            return false;
+
+        --count_;
+
+        if (block->count_ == 0)
+        {
+            Delete(block);
+            block = nullptr;
+            group->mask_ &= ~((BitField_t)1 << blockIdx);
+
+            if (group->mask_ == 0)
+                RemoveGroup(idx);
+        }
+
+        return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    // Calls fun(index, item) for all elements in index order
+    template<class TFun>
+    void Each(TFun fun)
+    {
+        uint groupIdx = 0;
+        for (uint w = 0; w < rootBits_.Count(); ++w)
+        {
+            for (BitField_t groupBits = rootBits_[w]; groupBits; groupBits &= groupBits - 1)
+            {
+                const uint groupBase = ((w << 6) + CountTrailingZeros64(groupBits)) << GROUP_BITS;
+                Group* group = groups_[groupIdx++];
+
+                for (BitField_t blockBits = group->mask_; blockBits; blockBits &= blockBits - 1)
+                {
+                    const uint b = CountTrailingZeros64(blockBits);
+                    group->blocks_[b]->Each(groupBase + (b << BLOCK_BITS), fun);
+                }
+            }
+        }
+    }
+
+    //-----------------------------------------------------------------------------
+    // Bytes held by the structure including the items
+    uint64 GetMemoryUsage() const
+    {
+        uint64 bytes = rootBits_.Capacity() * sizeof(BitField_t) + rootSums_.Capacity() * sizeof(uint) + groups_.Capacity() * sizeof(Group*);
+        for (uint64 g = 0; g < groups_.Count(); ++g)
+        {
+            const Group* group = groups_[g];
+            bytes += sizeof(Group);
+            for (uint i = 0; i < 64; ++i)
+            {
+                if (group->blocks_[i])
+                    bytes += sizeof(Block) + group->blocks_[i]->items_.Capacity() * sizeof(Item_t);
+            }
+        }
+        return bytes;
+    }
+
+private:
+    //-----------------------------------------------------------------------------
+    // 4096 slots, the same layout as SparseArray
+    struct Block
+    {
+        BitField_t bits_[64]{};
+        uint16 sums_[64]{};
+        uint count_{};
+        hs::Array<Item_t> items_;
+
+        //-----------------------------------------------------------------------------
+        explicit Block(hs::Allocator* allocator)
+            : items_(allocator)
+        {
+        }
+
+        //-----------------------------------------------------------------------------
+        Item_t* Find(uint idx)
+        {
+            const uint word = (idx >> 6) & 63;
+            const BitField_t mask = (BitField_t)1 << (idx & 63);
+            if ((bits_[word] & mask) == 0)
+                return nullptr;
+
+            return &items_[sums_[word] + PopCount64(bits_[word] & (mask - 1))];
+        }
+
+        //-----------------------------------------------------------------------------
+        bool Insert(uint idx, Item_t&& newItem)
+        {
+            const uint word = (idx >> 6) & 63;
+            const BitField_t mask = (BitField_t)1 << (idx & 63);
+            if ((bits_[word] & mask) != 0)
+                return false;
+
+            items_.Insert(sums_[word] + PopCount64(bits_[word] & (mask - 1)), std::move(newItem));
+            bits_[word] |= mask;
+            for (uint i = word + 1; i < 64; ++i)
+                ++sums_[i];
+            ++count_;
+
+            return true;
+        }
+
+        //-----------------------------------------------------------------------------
+        bool Remove(uint idx)
+        {
+            const uint word = (idx >> 6) & 63;
+            const BitField_t mask = (BitField_t)1 << (idx & 63);
+            if ((bits_[word] & mask) == 0)
+                return false;
+
+            bits_[word] &= ~mask;
+            items_.Remove(sums_[word] + PopCount64(bits_[word] & (mask - 1)));
+            for (uint i = word + 1; i < 64; ++i)
+                --sums_[i];
+            --count_;
+
+            return true;
+        }
+
+        //-----------------------------------------------------------------------------
+        template<class TFun>
+        void Each(uint base, TFun& fun)
+        {
+            Item_t* item = items_.Data();
+            for (uint w = 0; w < 64; ++w)
+            {
+                for (BitField_t bits = bits_[w]; bits; bits &= bits - 1)
+                    fun(base + (w << 6) + CountTrailingZeros64(bits), *item++);
+            }
+        }
+    };
+
+    //-----------------------------------------------------------------------------
+    // 64 blocks, mask_ has a bit for each existing block
+    struct Group
+    {
+        BitField_t mask_{};
+        Block* blocks_[64]{};
+    };
+
+    hs::Allocator*      allocator_;
+    hs::Array<BitField_t> rootBits_;
+    hs::Array<uint>     rootSums_;
+    hs::Array<Group*>   groups_;
+    uint                count_{};
+
+    //-----------------------------------------------------------------------------
+    template<class T, class ...ArgsT>
+    T* New(ArgsT&&... args)
+    {
+        return new(allocator_->Allocate(sizeof(T), alignof(T))) T(std::forward<ArgsT>(args)...);
+    }
+
+    //-----------------------------------------------------------------------------
+    template<class T>
+    void Delete(T* object)
+    {
+        object->~T();
+        allocator_->Free(object, sizeof(T));
+    }
+
+    //-----------------------------------------------------------------------------
+    Group* FindGroup(uint idx) const
+    {
+        const uint groupKey = idx >> GROUP_BITS;
+        const uint word = groupKey >> 6;
+        if (word >= rootBits_.Count())
+            return nullptr;
+
+        const BitField_t mask = (BitField_t)1 << (groupKey & 63);
+        if ((rootBits_[word] & mask) == 0)
+            return nullptr;
+
+        return groups_[rootSums_[word] + PopCount64(rootBits_[word] & (mask - 1))];
+    }
+
+    //-----------------------------------------------------------------------------
+    Block* FindBlock(uint idx) const
+    {
+        Group* group = FindGroup(idx);
+        return group ? group->blocks_[(idx >> BLOCK_BITS) & 63] : nullptr;
+    }
+
+    //-----------------------------------------------------------------------------
+    Group* AddGroup(uint idx)
+    {
+        const uint groupKey = idx >> GROUP_BITS;
+        const uint word = groupKey >> 6;
+        if (word >= rootBits_.Count())
+        {
+            const uint total = rootBits_.Count() ? rootSums_.Last() + PopCount64(rootBits_.Last()) : 0;
+            const uint64 oldCount = rootBits_.Count();
+            rootBits_.Resize(word + 1);
+            for (uint64 i = oldCount; i <= word; ++i)
+                rootSums_.Add(total);
+        }
+
+        const BitField_t mask = (BitField_t)1 << (groupKey & 63);
+        Group* group = New<Group>();
+        groups_.Insert(rootSums_[word] + PopCount64(rootBits_[word] & (mask - 1)), group);
+
+        rootBits_[word] |= mask;
+        for (uint64 i = word + 1; i < rootSums_.Count(); ++i)
+            ++rootSums_[i];
+
+        return group;
+    }
+
+    //-----------------------------------------------------------------------------
+    void RemoveGroup(uint idx)
+    {
+        const uint groupKey = idx >> GROUP_BITS;
+        const uint word = groupKey >> 6;
+        const BitField_t mask = (BitField_t)1 << (groupKey & 63);
+
+        rootBits_[word] &= ~mask;
+        const uint groupIdx = rootSums_[word] + PopCount64(rootBits_[word] & (mask - 1));
+        Delete(groups_[groupIdx]);
+        groups_.Remove(groupIdx);
+
+        for (uint64 i = word + 1; i < rootSums_.Count(); ++i)
+            --rootSums_[i];
+    }
+};
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "Array.h"
+
+#include <cassert>
+#include <functional>
+#include <utility>
+
+using namespace hs;
+
+//------------------------------------------------------------------------------
+// Binary heap of handles with keys where every handle knows its position in the heap,
+// keys of queued handles can be changed and any handle removed in O(log n).
+// Handles are small dense indices (node ids, event slots), positions_ has one entry
+// per handle up to the highest one ever added.
+template<class Key_t, class Compare = std::less<Key_t>>
+class IndexedHeap
+{
+public:
+    using Handle_t = uint;
+
+    //------------------------------------------------------------------------------
+    IndexedHeap()
+        : IndexedHeap(GetDefaultAllocator())
+    {
+    }
+
+    //------------------------------------------------------------------------------
+    explicit IndexedHeap(Allocator* allocator, Compare compare = Compare())
+        : nodes_(allocator)
+        , positions_(allocator)
+        , compare_(std::move(compare))
+    {
+    }
+
+    //------------------------------------------------------------------------------
+    size_t Count() const
+    {
+        return nodes_.Count();
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsEmpty() const
+    {
+        return nodes_.IsEmpty();
+    }
+
+    //------------------------------------------------------------------------------
+    // Sizes the position table for handles [0, handleCount) and the heap for as many nodes
+    void Reserve(uint handleCount)
+    {
+        nodes_.Reserve(handleCount);
+        if (handleCount)
+            EnsureHandle(handleCount - 1);
+    }
+
+    //------------------------------------------------------------------------------
+    void Clear()
+    {
+        for (uint64 i = 0; i < nodes_.Count(); ++i)
+            positions_[nodes_[i].handle_] = POSITION_NONE;
+        nodes_.Clear();
+    }
+
+    //------------------------------------------------------------------------------
+    bool Contains(Handle_t handle) const
+    {
+        return handle < positions_.Count() && positions_[handle] != POSITION_NONE;
+    }
+
+    //------------------------------------------------------------------------------
+    const Key_t& GetKey(Handle_t handle) const
+    {
+        assert(Contains(handle));
+        return nodes_[positions_[handle]].key_;
+    }
+
+    //------------------------------------------------------------------------------
+    Handle_t Top() const
+    {
+        assert(Count());
+        return nodes_[0].handle_;
+    }
+
+    //------------------------------------------------------------------------------
+    const Key_t& TopKey() const
+    {
+        assert(Count());
+        return nodes_[0].key_;
+    }
+
+    //------------------------------------------------------------------------------
+    void Add(Handle_t handle, Key_t key)
+    {
+        EnsureHandle(handle);
+        assert(positions_[handle] == POSITION_NONE && "Handle is already in the heap");
+
+        nodes_.Add(Node{ std::move(key), handle });
+        Node node = std::move(nodes_.Last());
+        SiftUp(nodes_.Count() - 1, std::move(node));
+    }
+
+    //------------------------------------------------------------------------------
+    Handle_t RemoveTop()
+    {
+        assert(Count());
+
+        const Handle_t handle = nodes_[0].handle_;
+        RemoveAt(0);
+        return handle;
+    }
+
+    //------------------------------------------------------------------------------
+    void Remove(Handle_t handle)
+    {
+        assert(Contains(handle));
+        RemoveAt(positions_[handle]);
+    }
+
+    //------------------------------------------------------------------------------
+    // The new key can't compare after the current one, only moves towards the top
+    void DecreaseKey(Handle_t handle, Key_t key)
+    {
+        assert(Contains(handle));
+
+        const uint pos = positions_[handle];
+        assert(!compare_(nodes_[pos].key_, key) && "DecreaseKey with a key that compares after the current one");
+
+        SiftUp(pos, Node{ std::move(key), handle });
+    }
+
+    //------------------------------------------------------------------------------
+    // The new key can't compare before the current one, only moves away from the top
+    void IncreaseKey(Handle_t handle, Key_t key)
+    {
+        assert(Contains(handle));
+
+        const uint pos = positions_[handle];
+        assert(!compare_(key, nodes_[pos].key_) && "IncreaseKey with a key that compares before the current one");
+
+        SiftDown(pos, Node{ std::move(key), handle });
+    }
+
+    //------------------------------------------------------------------------------
+    // Adds the handle or changes its key in whichever direction
+    void Update(Handle_t handle, Key_t key)
+    {
+        if (!Contains(handle))
+        {
+            Add(handle, std::move(key));
+            return;
+        }
+
+        const uint pos = positions_[handle];
+        if (compare_(key, nodes_[pos].key_))
+            SiftUp(pos, Node{ std::move(key), handle });
+        else
+            SiftDown(pos, Node{ std::move(key), handle });
+    }
+
+private:
+    static constexpr uint POSITION_NONE = (uint)-1;
+
+    struct Node
+    {
+        Key_t key_;
+        Handle_t handle_;
+    };
+
+    Array<Node> nodes_;
+    Array<uint> positions_;
+    Compare compare_;
+
+    //------------------------------------------------------------------------------
+    void EnsureHandle(Handle_t handle)
+    {
+        if (handle < positions_.Count())
+            return;
+
+        const uint64 oldCount = positions_.Count();
+        positions_.ResizeUninitialized(handle + 1);
+        for (uint64 i = oldCount; i < positions_.Count(); ++i)
+            positions_[i] = POSITION_NONE;
+    }
+
+    //------------------------------------------------------------------------------
+    // Node at the position becomes a hole which the last node fills
+    void RemoveAt(uint pos)
+    {
+        positions_[nodes_[pos].handle_] = POSITION_NONE;
+
+        Node last = std::move(nodes_.Last());
+        nodes_.RemoveLast();
+        if (pos == nodes_.Count())
+            return;
+
+        // The last node can belong above or below the hole when it's not on the path from the root
+        if (pos != 0 && compare_(last.key_, nodes_[(pos - 1) / 2].key_))
+            SiftUp(pos, std::move(last));
+        else
+            SiftDown(pos, std::move(last));
+    }
+
+    //------------------------------------------------------------------------------
+    void Place(uint64 pos, Node&& node)
+    {
+        positions_[node.handle_] = (uint)pos;
+        nodes_[pos] = std::move(node);
+    }
+
+    //------------------------------------------------------------------------------
+    // pos is a hole, moves parents down until node fits
+    void SiftUp(uint64 pos, Node&& node)
+    {
+        while (pos != 0)
+        {
+            const uint64 parent = (pos - 1) / 2;
+            if (!compare_(node.key_, nodes_[parent].key_))
+                break;
+
+            Place(pos, std::move(nodes_[parent]));
+            pos = parent;
+        }
+
+        Place(pos, std::move(node));
+    }
+
+    //------------------------------------------------------------------------------
+    // pos is a hole, moves the better child up until node fits
+    void SiftDown(uint64 pos, Node&& node)
+    {
+        const uint64 count = nodes_.Count();
+        while (true)
+        {
+            uint64 child = 2 * pos + 1;
+            if (child >= count)
+                break;
+
+            if (child + 1 < count && compare_(nodes_[child + 1].key_, nodes_[child].key_))
+                ++child;
+
+            if (!compare_(nodes_[child].key_, node.key_))
+                break;
+
+            Place(pos, std::move(nodes_[child]));
+            pos = child;
+        }
+
+        Place(pos, std::move(node));
+    }
+};
@@ -0,0 +1,444 @@
+#pragma once
+
+#include "Types.h"
+#include "ps_Math.h"
+#include "Allocator.h"
+
+#include <cassert>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <utility>
+
+namespace hs
+{
+//------------------------------------------------------------------------------
+// Array which keeps up to N elements inside of the object and only goes to the
+// allocator when it grows past that. Has the same interface as hs::Array.
+template<class T, uint64 N>
+class InlineArray
+{
+    static_assert(N > 0, "Use hs::Array for arrays without inline storage");
+
+public:
+    //------------------------------------------------------------------------------
+    static constexpr uint64 IndexBad()
+    {
+        return (uint64)-1;
+    }
+
+    //------------------------------------------------------------------------------
+    static constexpr uint64 InlineCapacity()
+    {
+        return N;
+    }
+
+    //------------------------------------------------------------------------------
+    InlineArray() = default;
+
+    //------------------------------------------------------------------------------
+    explicit InlineArray(Allocator* allocator)
+        : allocator_(allocator)
+    {
+        hs_assert(allocator_);
+    }
+
+    //------------------------------------------------------------------------------
+    InlineArray(std::initializer_list<T> elements, Allocator* allocator = GetDefaultAllocator())
+        : allocator_(allocator)
+    {
+        hs_assert(allocator_);
+        Reserve(elements.size());
+        for (auto&& e : elements)
+        {
+            Add(std::forward<decltype(e)>(e));
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    ~InlineArray()
+    {
+        Clear();
+        if (IsOnHeap())
+            allocator_->Free(heapItems_, sizeof(T) * capacity_);
+    }
+
+    //------------------------------------------------------------------------------
+    // The copy uses the allocator of the source array
+    InlineArray(const InlineArray& other)
+        : allocator_(other.allocator_)
+    {
+        Reserve(other.count_);
+        for (uint64 i = 0; i < other.count_; ++i)
+            new(Data() + i) T(other[i]);
+        count_ = other.count_;
+    }
+
+    //------------------------------------------------------------------------------
+    // Keeps the allocator of this array
+    InlineArray& operator=(const InlineArray& other)
+    {
+        if (this == &other)
+            return *this;
+
+        Clear();
+        Reserve(other.count_);
+        for (uint64 i = 0; i < other.count_; ++i)
+            new(Data() + i) T(other[i]);
+        count_ = other.count_;
+
+        return *this;
+    }
+
+    //------------------------------------------------------------------------------
+    InlineArray(InlineArray&& other)
+        : allocator_(other.allocator_)
+    {
+        TakeOver(other);
+    }
+
+    //------------------------------------------------------------------------------
+    // Takes over the memory together with the allocator it came from
+    InlineArray& operator=(InlineArray&& other)
+    {
+        if (this == &other)
+            return *this;
+
+        Clear();
+        if (IsOnHeap())
+            allocator_->Free(heapItems_, sizeof(T) * capacity_);
+        capacity_ = N;
+
+        allocator_ = other.allocator_;
+        TakeOver(other);
+
+        return *this;
+    }
+
+    //------------------------------------------------------------------------------
+    Allocator* GetAllocator() const
+    {
+        return allocator_;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 Count() const
+    {
+        return count_;
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsEmpty() const
+    {
+        return count_ == 0;
+    }
+
+    //------------------------------------------------------------------------------
+    // True while the elements live inside of the object
+    bool IsInline() const
+    {
+        return !IsOnHeap();
+    }
+
+    //------------------------------------------------------------------------------
+    const T& operator[](uint64 index) const
+    {
+        hs_assert(index < count_);
+        return Data()[index];
+    }
+
+    //------------------------------------------------------------------------------
+    T& operator[](uint64 index)
+    {
+        hs_assert(index < count_);
+        return Data()[index];
+    }
+
+    //------------------------------------------------------------------------------
+    template<class ...ArgsT>
+    void EmplaceBack(ArgsT ...args)
+    {
+        if (count_ == capacity_)
+            Grow(capacity_ << 1);
+
+        hs_assert(count_ < capacity_);
+
+        new(Data() + count_) T(std::forward<ArgsT>(args)...);
+        ++count_;
+    }
+
+    //------------------------------------------------------------------------------
+    template<class ...ArgsT>
+    void Emplace(uint64 index, ArgsT ...args)
+    {
+        hs_assert(index <= count_);
+        if (index == count_)
+        {
+            EmplaceBack(std::forward<ArgsT>(args)...);
+            return;
+        }
+
+        if (count_ == capacity_)
+            Grow(capacity_ << 1);
+
+        T* items = Data();
+
+        // Move items by one to the right
+        if constexpr (IsTriviallyRelocatable_v<T>)
+        {
+            memmove(&items[index + 1], &items[index], (count_ - index) * sizeof(T));
+            new(items + index) T(std::forward<ArgsT>(args)...);
+        }
+        else
+        {
+            // count_ is at least 1, otherwise there is early exit
+            new(items + count_) T(std::move(items[count_ - 1]));
+            for (T* item = items + count_ - 1; item != items + index; --item)
+                *item = std::move(*(item - 1));
+
+            items[index] = T(std::forward<ArgsT>(args)...);
+        }
+
+        ++count_;
+    }
+
+    //------------------------------------------------------------------------------
+    void Add(const T& item)
+    {
+        // Check for aliasing
+        hs_assert((&item < Data() || &item >= Data() + capacity_) && "Inserting item from array to itself is not handled");
+        EmplaceBack(item);
+    }
+
+    //------------------------------------------------------------------------------
+    void Add(T&& item)
+    {
+        // Check for aliasing
+        hs_assert((&item < Data() || &item >= Data() + capacity_) && "Inserting item from array to itself is not handled");
+        EmplaceBack(std::move(item));
+    }
+
+    //------------------------------------------------------------------------------
+    void Insert(uint64 index, const T& item)
+    {
+        // Check for aliasing
+        hs_assert((&item < Data() || &item >= Data() + capacity_) && "Inserting item from array to itself is not handled");
+        Emplace(index, item);
+    }
+
+    //------------------------------------------------------------------------------
+    void Insert(uint64 index, T&& item)
+    {
+        // Check for aliasing
+        hs_assert((&item < Data() || &item >= Data() + capacity_) && "Inserting item from array to itself is not handled");
+        Emplace(index, std::move(item));
+    }
+
+    //------------------------------------------------------------------------------
+    void Remove(uint64 index)
+    {
+        hs_assert(index < count_);
+
+        T* items = Data();
+        if constexpr (IsTriviallyRelocatable_v<T>)
+        {
+            items[index].~T();
+            memmove(&items[index], &items[index + 1], (count_ - index - 1) * sizeof(T));
+        }
+        else
+        {
+            for (T* item = items + index; item != items + count_ - 1; ++item)
+                *item = std::move(item[1]);
+            items[count_ - 1].~T();
+        }
+
+        --count_;
+    }
+
+    //------------------------------------------------------------------------------
+    void RemoveLast()
+    {
+        Remove(count_ - 1);
+    }
+
+    //------------------------------------------------------------------------------
+    void Clear()
+    {
+        T* items = Data();
+        for (uint64 i = 0; i < count_; ++i)
+        {
+            items[i].~T();
+        }
+        count_ = 0;
+    }
+
+    //------------------------------------------------------------------------------
+    void Reserve(uint64 capacity)
+    {
+        if (capacity <= capacity_)
+            return;
+
+        Grow(capacity);
+    }
+
+    //------------------------------------------------------------------------------
+    const T& First() const
+    {
+        hs_assert(count_);
+        return Data()[0];
+    }
+
+    //------------------------------------------------------------------------------
+    T& First()
+    {
+        hs_assert(count_);
+        return Data()[0];
+    }
+
+    //------------------------------------------------------------------------------
+    const T& Last() const
+    {
+        hs_assert(count_);
+        return Data()[count_ - 1];
+    }
+
+    //------------------------------------------------------------------------------
+    T& Last()
+    {
+        hs_assert(count_);
+        return Data()[count_ - 1];
+    }
+
+    //------------------------------------------------------------------------------
+    T* Data()
+    {
+        return IsOnHeap() ? heapItems_ : (T*)inlineItems_;
+    }
+
+    //------------------------------------------------------------------------------
+    const T* Data() const
+    {
+        return IsOnHeap() ? heapItems_ : (const T*)inlineItems_;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 IndexOf(const T& item) const
+    {
+        const T* items = Data();
+        for (uint64 i = 0; i < count_; ++i)
+        {
+            if (items[i] == item)
+                return i;
+        }
+
+        return IndexBad();
+    }
+
+    //------------------------------------------------------------------------------
+    // Iterators
+    //------------------------------------------------------------------------------
+    T* begin()
+    {
+        return Data();
+    }
+
+    //------------------------------------------------------------------------------
+    T* end()
+    {
+        return Data() + count_;
+    }
+
+private:
+    // Capacity equal to N means the elements are inline, the storage is never
+    // pointing into the object itself so the array can be relocated with memcpy
+    Allocator* allocator_{ GetDefaultAllocator() };
+    uint64 capacity_{ N };
+    uint64 count_{};
+    union
+    {
+        T* heapItems_;
+        alignas(T) byte inlineItems_[sizeof(T) * N];
+    };
+
+    //------------------------------------------------------------------------------
+    bool IsOnHeap() const
+    {
+        return capacity_ > N;
+    }
+
+    //------------------------------------------------------------------------------
+    void Grow(uint64 capacity)
+    {
+        hs_assert(capacity > capacity_);
+
+        if constexpr (IsTriviallyRelocatable_v<T>)
+        {
+            if (IsOnHeap())
+            {
+                heapItems_ = (T*)allocator_->Reallocate(heapItems_, sizeof(T) * capacity_, sizeof(T) * capacity, alignof(T));
+                capacity_ = capacity;
+                return;
+            }
+        }
+
+        T* newItems = (T*)allocator_->Allocate(sizeof(T) * capacity, alignof(T));
+        T* items = Data();
+        if constexpr (IsTriviallyRelocatable_v<T>)
+        {
+            memcpy(newItems, items, sizeof(T) * count_);
+        }
+        else
+        {
+            for (uint64 i = 0; i < count_; ++i)
+            {
+                new(newItems + i) T(std::move(items[i]));
+                items[i].~T();
+            }
+        }
+
+        if (IsOnHeap())
+            allocator_->Free(heapItems_, sizeof(T) * capacity_);
+
+        heapItems_ = newItems;
+        capacity_ = capacity;
+    }
+
+    //------------------------------------------------------------------------------
+    // Expects this to be empty with inline capacity and the same allocator as other
+    void TakeOver(InlineArray& other)
+    {
+        if (other.IsOnHeap())
+        {
+            heapItems_ = other.heapItems_;
+            capacity_ = other.capacity_;
+            count_ = other.count_;
+
+            other.capacity_ = N;
+            other.count_ = 0;
+            return;
+        }
+
+        T* items = (T*)inlineItems_;
+        T* otherItems = (T*)other.inlineItems_;
+        if constexpr (IsTriviallyRelocatable_v<T>)
+        {
+            memcpy(items, otherItems, sizeof(T) * other.count_);
+        }
+        else
+        {
+            for (uint64 i = 0; i < other.count_; ++i)
+            {
+                new(items + i) T(std::move(otherItems[i]));
+                otherItems[i].~T();
+            }
+        }
+        count_ = other.count_;
+        other.count_ = 0;
+    }
+};
+
+}
+
+//------------------------------------------------------------------------------
+template<class T, uint64 N>
+struct IsTriviallyRelocatable<hs::InlineArray<T, N>> : IsTriviallyRelocatable<T> {};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "Types.h"
+#include "Allocator.h"
+#include "Heap.h"
+
+#include <atomic>
+#include <cassert>
+#include <new>
+#include <utility>
+
+//------------------------------------------------------------------------------
+// Relaxed concurrent priority queue made of many sequential heaps each behind its own
+// try-lock (MultiQueue). Add goes to a random heap, RemoveTop peeks the cached top keys
+// of two random heaps and pops the lower one, so threads rarely meet on the same lock.
+// The price is order: a pop returns one of the lowest keys, not always the lowest,
+// with the error growing with the number of heaps (a few times their count on average).
+// Lower keys come out first, keys are full 64 bit except for KEY_EMPTY.
+template<class Value_t>
+class MultiQueue
+{
+public:
+    using Key_t = uint64;
+
+    static constexpr Key_t KEY_EMPTY = (Key_t)-1;
+
+    struct Entry
+    {
+        Key_t key_;
+        Value_t value_;
+
+        //------------------------------------------------------------------------------
+        bool operator<(const Entry& other) const
+        {
+            return key_ < other.key_;
+        }
+    };
+
+    //------------------------------------------------------------------------------
+    // A few heaps per thread, 2 to 4 times the thread count keeps contention and the
+    // rank error low. All heaps grow from the allocator under their own locks, so
+    // threads holding different heaps use it at the same time and it has to be thread-safe.
+    explicit MultiQueue(uint queueCount, Allocator* allocator = GetDefaultAllocator())
+        : allocator_(allocator)
+        , queueCount_(queueCount)
+    {
+        assert(queueCount >= 2);
+        assert(allocator_->IsThreadSafe() && "Heaps of different queues allocate concurrently");
+
+        queues_ = (Queue*)allocator_->Allocate(sizeof(Queue) * queueCount_, alignof(Queue));
+        for (uint i = 0; i < queueCount_; ++i)
+            new(queues_ + i) Queue(allocator_);
+    }
+
+    //------------------------------------------------------------------------------
+    ~MultiQueue()
+    {
+        for (uint i = 0; i < queueCount_; ++i)
+            queues_[i].~Queue();
+        allocator_->Free(queues_, sizeof(Queue) * queueCount_);
+    }
+
+    //------------------------------------------------------------------------------
+    MultiQueue(const MultiQueue&) = delete;
+
+    //------------------------------------------------------------------------------
+    MultiQueue& operator=(const MultiQueue&) = delete;
+
+    //------------------------------------------------------------------------------
+    // Can be called from any thread
+    void Add(Key_t key, Value_t value)
+    {
+        assert(key != KEY_EMPTY);
+
+        while (true)
+        {
+            Queue& queue = queues_[Random() % queueCount_];
+            if (!queue.TryLock())
+                continue;
+
+            queue.heap_.Add(Entry{ key, std::move(value) });
+            queue.UpdateTop();
+            queue.Unlock();
+            return;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // Can be called from any thread, returns false when all heaps looked empty
+    bool TryRemoveTop(Entry& out)
+    {
+        while (true)
+        {
+            Queue* a = &queues_[Random() % queueCount_];
+            Queue* b = &queues_[Random() % queueCount_];
+            if (b->topKey_.load(std::memory_order_relaxed) < a->topKey_.load(std::memory_order_relaxed))
+                std::swap(a, b);
+
+            if (a->topKey_.load(std::memory_order_relaxed) == KEY_EMPTY)
+            {
+                // Both random picks empty, only give up when every heap is
+                if (IsEmpty())
+                    return false;
+                continue;
+            }
+
+            if (!a->TryLock())
+                continue;
+
+            // Another thread could have taken the last element since the peek
+            if (a->heap_.IsEmpty())
+            {
+                a->Unlock();
+                continue;
+            }
+
+            out = a->heap_.RemoveTop();
+            a->UpdateTop();
+            a->Unlock();
+            return true;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // Snapshot, only exact when no other thread is adding or removing
+    bool IsEmpty() const
+    {
+        for (uint i = 0; i < queueCount_; ++i)
+        {
+            if (queues_[i].topKey_.load(std::memory_order_acquire) != KEY_EMPTY)
+                return false;
+        }
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    // Snapshot, only exact when no other thread is adding or removing
+    uint64 Count() const
+    {
+        uint64 count = 0;
+        for (uint i = 0; i < queueCount_; ++i)
+            count += queues_[i].count_.load(std::memory_order_relaxed);
+        return count;
+    }
+
+private:
+    //------------------------------------------------------------------------------
+    // One heap and its lock, top key and count readable without the lock
+    struct alignas(CACHE_LINE_SIZE) Queue
+    {
+        std::atomic<bool> locked_{};
+        std::atomic<Key_t> topKey_{ KEY_EMPTY };
+        std::atomic<uint64> count_{};
+        Heap<Entry> heap_;
+
+        //------------------------------------------------------------------------------
+        explicit Queue(Allocator* allocator)
+            : heap_(allocator)
+        {
+        }
+
+        //------------------------------------------------------------------------------
+        bool TryLock()
+        {
+            return !locked_.load(std::memory_order_relaxed) && !locked_.exchange(true, std::memory_order_acquire);
+        }
+
+        //------------------------------------------------------------------------------
+        void Unlock()
+        {
+            locked_.store(false, std::memory_order_release);
+        }
+
+        //------------------------------------------------------------------------------
+        // Called with the lock held
+        void UpdateTop()
+        {
+            topKey_.store(heap_.IsEmpty() ? KEY_EMPTY : heap_.Top().key_, std::memory_order_release);
+            count_.store(heap_.Count(), std::memory_order_relaxed);
+        }
+    };
+
+    Allocator*  allocator_;
+    Queue*      queues_;
+    uint        queueCount_;
+
+    //------------------------------------------------------------------------------
+    // Per thread xorshift, picking heaps doesn't need a good generator but has to be cheap
+    static uint64 Random()
+    {
+        thread_local uint64 state = 0;
+        if (state == 0)
+            state = ((uint64)(uintptr_t)&state * 0x9E3779B97F4A7C15ull) | 1;
+
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Array.h"
+#include "ps_Math.h"
+
+#include <cassert>
+#include <utility>
+
+using namespace hs;
+
+//------------------------------------------------------------------------------
+// Priority queue for monotone integer keys, every added key has to be at least the last
+// removed one (Dijkstra distances, timers). Bucket i > 0 holds keys whose highest bit
+// differing from the last removed key is bit i - 1, bucket 0 keys equal to it. When bucket
+// 0 runs empty the first non empty bucket is redistributed around its minimum, each key
+// only moves to lower buckets so it's moved at most 32 times in total, no comparisons
+// between keys except for finding that minimum.
+template<class Value_t>
+class RadixHeap
+{
+public:
+    using Key_t = uint;
+
+    struct Entry
+    {
+        Key_t key_;
+        Value_t value_;
+    };
+
+    //------------------------------------------------------------------------------
+    RadixHeap()
+        : RadixHeap(GetDefaultAllocator())
+    {
+    }
+
+    //------------------------------------------------------------------------------
+    explicit RadixHeap(Allocator* allocator)
+    {
+        for (Array<Entry>& bucket : buckets_)
+            bucket = Array<Entry>(allocator);
+    }
+
+    //------------------------------------------------------------------------------
+    size_t Count() const
+    {
+        return count_;
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsEmpty() const
+    {
+        return count_ == 0;
+    }
+
+    //------------------------------------------------------------------------------
+    // The lowest key which can still be added
+    Key_t GetLastKey() const
+    {
+        return last_;
+    }
+
+    //------------------------------------------------------------------------------
+    void Add(Key_t key, Value_t value)
+    {
+        assert(key >= last_ && "RadixHeap keys have to be monotone");
+
+        buckets_[BucketIndex(key)].Add(Entry{ key, std::move(value) });
+        ++count_;
+    }
+
+    //------------------------------------------------------------------------------
+    Key_t TopKey()
+    {
+        assert(count_);
+
+        Pull();
+        return last_;
+    }
+
+    //------------------------------------------------------------------------------
+    Entry RemoveTop()
+    {
+        assert(count_);
+
+        Pull();
+        Entry entry = std::move(buckets_[0].Last());
+        buckets_[0].RemoveLast();
+        --count_;
+
+        return entry;
+    }
+
+private:
+    static constexpr uint BUCKET_COUNT = 33;
+
+    Array<Entry>    buckets_[BUCKET_COUNT];
+    Key_t           last_{};
+    uint64          count_{};
+
+    //------------------------------------------------------------------------------
+    uint BucketIndex(Key_t key) const
+    {
+        return key == last_ ? 0 : Log2Floor64(key ^ last_) + 1;
+    }
+
+    //------------------------------------------------------------------------------
+    // Makes sure bucket 0 has the minimum keys
+    void Pull()
+    {
+        if (!buckets_[0].IsEmpty())
+            return;
+
+        uint i = 1;
+        while (buckets_[i].IsEmpty())
+            ++i;
+
+        Array<Entry>& bucket = buckets_[i];
+        Key_t minKey = bucket[0].key_;
+        for (uint64 j = 1; j < bucket.Count(); ++j)
+            minKey = bucket[j].key_ < minKey ? bucket[j].key_ : minKey;
+
+        // All keys in the bucket share the bits above i - 1 with the new last so they go lower
+        last_ = minKey;
+        for (uint64 j = 0; j < bucket.Count(); ++j)
+            buckets_[BucketIndex(bucket[j].key_)].Add(std::move(bucket[j]));
+        bucket.Clear();
+    }
+};
@@ -0,0 +1,389 @@
+#pragma once
+
+#include "Types.h"
+#include "Array.h"
+#include "Span.h"
+
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <tuple>
+#include <utility>
+
+namespace hs
+{
+//------------------------------------------------------------------------------
+// Structure of arrays, every field of a row lives in its own contiguous column so
+// loops touching a subset of the fields only load those. Grows the same way as
+// hs::Array, each column is cache line aligned.
+template<class... Ts>
+class SoaArray
+{
+    static_assert(sizeof...(Ts) > 0, "SoaArray needs at least one column");
+
+public:
+    static constexpr uint64 COLUMN_COUNT = sizeof...(Ts);
+
+    template<uint64 I>
+    using Column_t = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    //------------------------------------------------------------------------------
+    SoaArray() = default;
+
+    //------------------------------------------------------------------------------
+    explicit SoaArray(Allocator* allocator)
+        : allocator_(allocator)
+    {
+        hs_assert(allocator_);
+    }
+
+    //------------------------------------------------------------------------------
+    ~SoaArray()
+    {
+        Reset();
+    }
+
+    //------------------------------------------------------------------------------
+    SoaArray(const SoaArray&) = delete;
+
+    //------------------------------------------------------------------------------
+    SoaArray& operator=(const SoaArray&) = delete;
+
+    //------------------------------------------------------------------------------
+    SoaArray(SoaArray&& other)
+        : allocator_(other.allocator_)
+        , capacity_(other.capacity_)
+        , count_(other.count_)
+        , growth_(other.growth_)
+        , columns_(other.columns_)
+    {
+        other.capacity_ = 0;
+        other.count_ = 0;
+        other.columns_ = {};
+    }
+
+    //------------------------------------------------------------------------------
+    SoaArray& operator=(SoaArray&& other)
+    {
+        if (this == &other)
+            return *this;
+
+        Reset();
+
+        allocator_ = other.allocator_;
+        capacity_ = other.capacity_;
+        count_ = other.count_;
+        growth_ = other.growth_;
+        columns_ = other.columns_;
+
+        other.capacity_ = 0;
+        other.count_ = 0;
+        other.columns_ = {};
+
+        return *this;
+    }
+
+    //------------------------------------------------------------------------------
+    Allocator* GetAllocator() const
+    {
+        return allocator_;
+    }
+
+    //------------------------------------------------------------------------------
+    void SetGrowth(ArrayGrowth growth)
+    {
+        growth_ = growth;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 Count() const
+    {
+        return count_;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 Capacity() const
+    {
+        return capacity_;
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsEmpty() const
+    {
+        return count_ == 0;
+    }
+
+    //------------------------------------------------------------------------------
+    // Whole column as a contiguous span
+    template<uint64 I>
+    Span<Column_t<I>> Column()
+    {
+        return Span<Column_t<I>>(HS_ASSUME_ALIGNED(std::get<I>(columns_), CACHE_LINE_SIZE), count_);
+    }
+
+    //------------------------------------------------------------------------------
+    template<uint64 I>
+    Span<const Column_t<I>> Column() const
+    {
+        return Span<const Column_t<I>>(HS_ASSUME_ALIGNED(std::get<I>(columns_), CACHE_LINE_SIZE), count_);
+    }
+
+    //------------------------------------------------------------------------------
+    template<uint64 I>
+    Column_t<I>& Get(uint64 index)
+    {
+        hs_assert(index < count_);
+        return std::get<I>(columns_)[index];
+    }
+
+    //------------------------------------------------------------------------------
+    template<uint64 I>
+    const Column_t<I>& Get(uint64 index) const
+    {
+        hs_assert(index < count_);
+        return std::get<I>(columns_)[index];
+    }
+
+    //------------------------------------------------------------------------------
+    // References to all fields of the row
+    std::tuple<Ts&...> operator[](uint64 index)
+    {
+        hs_assert(index < count_);
+        return RowAt(index, std::index_sequence_for<Ts...>());
+    }
+
+    //------------------------------------------------------------------------------
+    void Add(const Ts&... values)
+    {
+        EmplaceBack(values...);
+    }
+
+    //------------------------------------------------------------------------------
+    // One value per column, each is forwarded to the constructor of its column
+    template<class... ArgsT>
+    void EmplaceBack(ArgsT&&... args)
+    {
+        static_assert(sizeof...(ArgsT) == COLUMN_COUNT, "Expected one value per column");
+
+        if (count_ == capacity_)
+            SetCapacity(GrowCapacity(capacity_, growth_, MIN_CAPACITY));
+
+        ConstructRow(count_, std::index_sequence_for<Ts...>(), std::forward<ArgsT>(args)...);
+        ++count_;
+    }
+
+    //------------------------------------------------------------------------------
+    // O(1) remove which moves the last row into the hole, doesn't keep the order
+    void RemoveSwapBack(uint64 index)
+    {
+        hs_assert(index < count_);
+
+        const uint64 last = count_ - 1;
+        ForEachColumn([index, last](auto* column)
+        {
+            if (index != last)
+                column[index] = std::move(column[last]);
+            Destroy(column + last);
+        });
+
+        --count_;
+    }
+
+    //------------------------------------------------------------------------------
+    void RemoveLast()
+    {
+        RemoveSwapBack(count_ - 1);
+    }
+
+    //------------------------------------------------------------------------------
+    void Clear()
+    {
+        const uint64 count = count_;
+        ForEachColumn([count](auto* column)
+        {
+            for (uint64 i = 0; i < count; ++i)
+                Destroy(column + i);
+        });
+        count_ = 0;
+    }
+
+    //------------------------------------------------------------------------------
+    // Destroys all rows and releases the memory
+    void Reset()
+    {
+        Clear();
+
+        const uint64 capacity = capacity_;
+        Allocator* allocator = allocator_;
+        ForEachColumn([capacity, allocator](auto*& column)
+        {
+            if (column)
+                allocator->Free(column, capacity * sizeof(*column));
+            column = nullptr;
+        });
+        capacity_ = 0;
+    }
+
+    //------------------------------------------------------------------------------
+    void Reserve(uint64 capacity)
+    {
+        if (capacity <= capacity_)
+            return;
+
+        SetCapacity(capacity > MIN_CAPACITY ? capacity : MIN_CAPACITY);
+    }
+
+    //------------------------------------------------------------------------------
+    // Calls fun with references to all the fields of each row
+    template<class TFun>
+    void Each(TFun fun)
+    {
+        EachImpl(fun, std::index_sequence_for<Ts...>());
+    }
+
+    //------------------------------------------------------------------------------
+    // Iterators, dereference gives tuple of references so structured bindings work
+    //------------------------------------------------------------------------------
+    class Iterator
+    {
+    public:
+        //------------------------------------------------------------------------------
+        Iterator(SoaArray* array, uint64 index)
+            : array_(array)
+            , index_(index)
+        {
+        }
+
+        //------------------------------------------------------------------------------
+        std::tuple<Ts&...> operator*() const
+        {
+            return (*array_)[index_];
+        }
+
+        //------------------------------------------------------------------------------
+        Iterator& operator++()
+        {
+            ++index_;
+            return *this;
+        }
+
+        //------------------------------------------------------------------------------
+        bool operator!=(const Iterator& other) const
+        {
+            return index_ != other.index_;
+        }
+
+        //------------------------------------------------------------------------------
+        bool operator==(const Iterator& other) const
+        {
+            return index_ == other.index_;
+        }
+
+    private:
+        SoaArray* array_;
+        uint64 index_;
+    };
+
+    //------------------------------------------------------------------------------
+    Iterator begin()
+    {
+        return Iterator(this, 0);
+    }
+
+    //------------------------------------------------------------------------------
+    Iterator end()
+    {
+        return Iterator(this, count_);
+    }
+
+private:
+    static constexpr uint64 MIN_CAPACITY = 8;
+
+    Allocator* allocator_{ GetDefaultAllocator() };
+    uint64 capacity_{};
+    uint64 count_{};
+    ArrayGrowth growth_{ ArrayGrowth::Double };
+    std::tuple<Ts*...> columns_{};
+
+    //------------------------------------------------------------------------------
+    template<class T>
+    static void Destroy(T* item)
+    {
+        item->~T();
+    }
+
+    //------------------------------------------------------------------------------
+    template<class TFun, uint64... I>
+    void ForEachColumnImpl(TFun& fun, std::index_sequence<I...>)
+    {
+        (fun(std::get<I>(columns_)), ...);
+    }
+
+    //------------------------------------------------------------------------------
+    template<class TFun>
+    void ForEachColumn(TFun fun)
+    {
+        ForEachColumnImpl(fun, std::index_sequence_for<Ts...>());
+    }
+
+    //------------------------------------------------------------------------------
+    template<uint64... I>
+    std::tuple<Ts&...> RowAt(uint64 index, std::index_sequence<I...>)
+    {
+        return std::tuple<Ts&...>(std::get<I>(columns_)[index]...);
+    }
+
+    //------------------------------------------------------------------------------
+    template<uint64... I, class... ArgsT>
+    void ConstructRow(uint64 index, std::index_sequence<I...>, ArgsT&&... args)
+    {
+        (new(std::get<I>(columns_) + index) Ts(std::forward<ArgsT>(args)), ...);
+    }
+
+    //------------------------------------------------------------------------------
+    template<class TFun, uint64... I>
+    void EachImpl(TFun& fun, std::index_sequence<I...>)
+    {
+        std::tuple<Ts*...> columns = columns_;
+        for (uint64 i = 0; i < count_; ++i)
+            fun(std::get<I>(columns)[i]...);
+    }
+
+    //------------------------------------------------------------------------------
+    // Same relocation rules as hs::Array, applied to every column
+    void SetCapacity(uint64 capacity)
+    {
+        hs_assert(capacity >= count_);
+
+        const uint64 oldCapacity = capacity_;
+        const uint64 count = count_;
+        Allocator* allocator = allocator_;
+        ForEachColumn([oldCapacity, capacity, count, allocator](auto*& column)
+        {
+            using T = std::remove_reference_t<decltype(*column)>;
+            if constexpr (IsTriviallyRelocatable_v<T>)
+            {
+                column = (T*)allocator->Reallocate(column, oldCapacity * sizeof(T), capacity * sizeof(T), CACHE_LINE_SIZE);
+                hs_assert(IsAligned(column, CACHE_LINE_SIZE) && "Allocator doesn't honor the alignment");
+            }
+            else
+            {
+                T* newColumn = (T*)allocator->Allocate(capacity * sizeof(T), CACHE_LINE_SIZE);
+                hs_assert(IsAligned(newColumn, CACHE_LINE_SIZE) && "Allocator doesn't honor the alignment");
+                for (uint64 i = 0; i < count; ++i)
+                {
+                    new(newColumn + i) T(std::move(column[i]));
+                    column[i].~T();
+                }
+
+                if (column)
+                    allocator->Free(column, oldCapacity * sizeof(T));
+                column = newColumn;
+            }
+        });
+
+        capacity_ = capacity;
+    }
+};
+
+}
@@ -18,36 +18,28 @@ public:
     //------------------------------------------------------------------------------
     void Add(int x)
     {
-        // Find insert spot
-        int bot = 0;
-        int top = (int)values_.Count() - 1;
-        int idx = (top - bot) / 2;
+        // Values are kept in descending order so the minimum sits at the end
+        uint64 bot = 0;
+        uint64 top = values_.Count();
 
-        while (top > bot)
+        while (bot < top)
         {
-            if (values_[idx] < x)
-            {
+            uint64 idx = bot + (top - bot) / 2;
+            if (values_[idx] > x)
                 bot = idx + 1;
-            }
             else
-            {
-                top = idx - 1;
-            }
-            idx = bot + (int)std::ceil((top - bot) / 2);
+                top = idx;
         }
 
-        if (idx < values_.Count() && x > values_[idx])
-            ++idx;
-
-        values_.Insert(idx, x);
+        values_.Insert(bot, x);
     }
 
     //------------------------------------------------------------------------------
     int RemoveMin()
     {
-        int ret = values_[0];
+        int ret = values_.Last();
 
-        values_.Remove(0);
+        values_.RemoveLast();
 
         return ret;
     }
@@ -2,9 +2,14 @@
 
 #include "Types.h"
 
+#include <type_traits>
+
 namespace hs
 {
 
+template<class T>
+class SpanChunks;
+
 //------------------------------------------------------------------------------
 template<class T>
 class Span
@@ -51,15 +56,461 @@ public:
         return items_[index];
     }
 
+    //------------------------------------------------------------------------------
+    constexpr Span First(uint64 count) const
+    {
+        hs_assert(count <= count_);
+        return Span(items_, count);
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr Span Last(uint64 count) const
+    {
+        hs_assert(count <= count_);
+        return Span(items_ + count_ - count, count);
+    }
+
+    //------------------------------------------------------------------------------
+    // Count elements from offset, everything after offset when count is not given
+    constexpr Span Subspan(uint64 offset, uint64 count = (uint64)-1) const
+    {
+        hs_assert(offset <= count_);
+        if (count == (uint64)-1)
+            count = count_ - offset;
+        hs_assert(count <= count_ - offset);
+        return Span(items_ + offset, count);
+    }
+
+    //------------------------------------------------------------------------------
+    // Consecutive pieces of chunkSize elements, the last one can be shorter
+    constexpr SpanChunks<T> Chunks(uint64 chunkSize) const
+    {
+        hs_assert(chunkSize);
+        return SpanChunks<T>(items_, count_, chunkSize, chunkSize);
+    }
+
+    //------------------------------------------------------------------------------
+    // At most threadCount roughly equal pieces which start on a cache line (except
+    // the first one) so threads writing to their pieces never share a cache line.
+    // Falls back to element boundaries when elements don't tile the cache line.
+    SpanChunks<T> SplitForThreads(uint64 threadCount) const
+    {
+        hs_assert(threadCount);
+
+        const uint64 address = (uint64)(uintptr_t)items_;
+        const uint64 perLine = sizeof(T) <= CACHE_LINE_SIZE && CACHE_LINE_SIZE % sizeof(T) == 0 && address % sizeof(T) == 0
+            ? CACHE_LINE_SIZE / sizeof(T)
+            : 1;
+
+        // Elements before the first cache line boundary go to the first piece
+        const uint64 head = (perLine - (address % CACHE_LINE_SIZE) / sizeof(T) % perLine) % perLine;
+
+        uint64 chunkSize = (count_ + threadCount - 1) / threadCount;
+        chunkSize = (chunkSize + perLine - 1) / perLine * perLine;
+        if (!chunkSize)
+            chunkSize = perLine;
+
+        return SpanChunks<T>(items_, count_, chunkSize, head + chunkSize);
+    }
+
     //------------------------------------------------------------------------------
     operator Span<const T>() const
     {
         return Span<const T>(items_, count_);
     }
 
+    //------------------------------------------------------------------------------
+    // Iterators
+    //------------------------------------------------------------------------------
+    constexpr T* begin() const
+    {
+        return items_;
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr T* end() const
+    {
+        return items_ + count_;
+    }
+
+private:
+    T* items_{};
+    uint64 count_{};
+};
+
+//------------------------------------------------------------------------------
+// Partition of a span into consecutive pieces. The first piece has firstSize
+// elements, all the others chunkSize, the last one is clipped to the span.
+template<class T>
+class SpanChunks
+{
+public:
+    //------------------------------------------------------------------------------
+    constexpr SpanChunks(T* items, uint64 count, uint64 chunkSize, uint64 firstSize)
+        : items_(items)
+        , count_(count)
+        , chunkSize_(chunkSize)
+        , firstSize_(firstSize)
+    {
+        hs_assert(chunkSize_ && firstSize_);
+    }
+
+    //------------------------------------------------------------------------------
+    // Number of pieces, never returns empty pieces
+    constexpr uint64 Count() const
+    {
+        if (count_ == 0)
+            return 0;
+        if (count_ <= firstSize_)
+            return 1;
+        return 1 + (count_ - firstSize_ + chunkSize_ - 1) / chunkSize_;
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr Span<T> operator[](uint64 index) const
+    {
+        hs_assert(index < Count());
+        const uint64 begin = index ? firstSize_ + (index - 1) * chunkSize_ : 0;
+        const uint64 size = index ? chunkSize_ : firstSize_;
+        return Span<T>(items_ + begin, count_ - begin < size ? count_ - begin : size);
+    }
+
+    //------------------------------------------------------------------------------
+    // Iterators
+    //------------------------------------------------------------------------------
+    class Iterator
+    {
+    public:
+        //------------------------------------------------------------------------------
+        constexpr Iterator(const SpanChunks* chunks, uint64 index)
+            : chunks_(chunks)
+            , index_(index)
+        {}
+
+        //------------------------------------------------------------------------------
+        constexpr Span<T> operator*() const
+        {
+            return (*chunks_)[index_];
+        }
+
+        //------------------------------------------------------------------------------
+        constexpr Iterator& operator++()
+        {
+            ++index_;
+            return *this;
+        }
+
+        //------------------------------------------------------------------------------
+        constexpr bool operator==(const Iterator& other) const
+        {
+            return index_ == other.index_;
+        }
+
+        //------------------------------------------------------------------------------
+        constexpr bool operator!=(const Iterator& other) const
+        {
+            return index_ != other.index_;
+        }
+
+    private:
+        const SpanChunks* chunks_;
+        uint64 index_;
+    };
+
+    //------------------------------------------------------------------------------
+    constexpr Iterator begin() const
+    {
+        return Iterator(this, 0);
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr Iterator end() const
+    {
+        return Iterator(this, Count());
+    }
+
+private:
+    T* items_;
+    uint64 count_;
+    uint64 chunkSize_;
+    uint64 firstSize_;
+};
+
+//------------------------------------------------------------------------------
+// View of count elements which are stride bytes apart, e.g. one field of an array
+// of structs or one column of an image
+template<class T>
+class StridedSpan
+{
+public:
+    //------------------------------------------------------------------------------
+    constexpr StridedSpan() = default;
+
+    //------------------------------------------------------------------------------
+    constexpr StridedSpan(T* items, uint64 count, uint64 strideBytes)
+        : items_(items)
+        , count_(count)
+        , stride_(strideBytes)
+    {}
+
+    //------------------------------------------------------------------------------
+    constexpr StridedSpan(Span<T> span)
+        : items_(span.Data())
+        , count_(span.Count())
+        , stride_(sizeof(T))
+    {}
+
+    //------------------------------------------------------------------------------
+    constexpr T* Data() const
+    {
+        return items_;
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr uint64 Count() const
+    {
+        return count_;
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr uint64 Stride() const
+    {
+        return stride_;
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr bool IsEmpty() const
+    {
+        return count_ == 0;
+    }
+
+    //------------------------------------------------------------------------------
+    // Elements are next to each other and the view can be used as a plain Span
+    constexpr bool IsContiguous() const
+    {
+        return stride_ == sizeof(T);
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr T& operator[](uint64 index) const
+    {
+        hs_assert(index < count_);
+        return *(T*)((Byte_t*)items_ + index * stride_);
+    }
+
+    //------------------------------------------------------------------------------
+    operator StridedSpan<const T>() const
+    {
+        return StridedSpan<const T>(items_, count_, stride_);
+    }
+
+    //------------------------------------------------------------------------------
+    // Iterators
+    //------------------------------------------------------------------------------
+    class Iterator
+    {
+    public:
+        //------------------------------------------------------------------------------
+        constexpr Iterator(T* item, uint64 stride)
+            : item_(item)
+            , stride_(stride)
+        {}
+
+        //------------------------------------------------------------------------------
+        constexpr T& operator*() const
+        {
+            return *item_;
+        }
+
+        //------------------------------------------------------------------------------
+        constexpr Iterator& operator++()
+        {
+            item_ = (T*)((Byte_t*)item_ + stride_);
+            return *this;
+        }
+
+        //------------------------------------------------------------------------------
+        constexpr bool operator==(const Iterator& other) const
+        {
+            return item_ == other.item_;
+        }
+
+        //------------------------------------------------------------------------------
+        constexpr bool operator!=(const Iterator& other) const
+        {
+            return item_ != other.item_;
+        }
+
+    private:
+        T* item_;
+        uint64 stride_;
+    };
+
+    //------------------------------------------------------------------------------
+    constexpr Iterator begin() const
+    {
+        return Iterator(items_, stride_);
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr Iterator end() const
+    {
+        return Iterator((T*)((Byte_t*)items_ + count_ * stride_), stride_);
+    }
+
 private:
+    using Byte_t = std::conditional_t<std::is_const_v<T>, const byte, byte>;
+
     T* items_{};
     uint64 count_{};
+    uint64 stride_{ sizeof(T) };
+};
+
+//------------------------------------------------------------------------------
+// Row major 2D view, rows are pitch elements apart so a view can point into a part
+// of a bigger image without copying it
+template<class T>
+class Span2D
+{
+public:
+    //------------------------------------------------------------------------------
+    constexpr Span2D() = default;
+
+    //------------------------------------------------------------------------------
+    constexpr Span2D(T* items, uint64 width, uint64 height)
+        : Span2D(items, width, height, width)
+    {}
+
+    //------------------------------------------------------------------------------
+    constexpr Span2D(T* items, uint64 width, uint64 height, uint64 pitch)
+        : items_(items)
+        , width_(width)
+        , height_(height)
+        , pitch_(pitch)
+    {
+        hs_assert(pitch_ >= width_);
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr T* Data() const
+    {
+        return items_;
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr uint64 Width() const
+    {
+        return width_;
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr uint64 Height() const
+    {
+        return height_;
+    }
+
+    //------------------------------------------------------------------------------
+    // Distance between the starts of two rows in elements
+    constexpr uint64 Pitch() const
+    {
+        return pitch_;
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr bool IsEmpty() const
+    {
+        return width_ == 0 || height_ == 0;
+    }
+
+    //------------------------------------------------------------------------------
+    // Rows follow each other without gaps and the view can be used as a plain Span
+    constexpr bool IsContiguous() const
+    {
+        return pitch_ == width_ || height_ <= 1;
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr T& operator()(uint64 x, uint64 y) const
+    {
+        hs_assert(x < width_ && y < height_);
+        return items_[y * pitch_ + x];
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr Span<T> Row(uint64 y) const
+    {
+        hs_assert(y < height_);
+        return Span<T>(items_ + y * pitch_, width_);
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr StridedSpan<T> Column(uint64 x) const
+    {
+        hs_assert(x < width_);
+        return StridedSpan<T>(items_ + x, height_, pitch_ * sizeof(T));
+    }
+
+    //------------------------------------------------------------------------------
+    // All the elements, only valid for contiguous views
+    constexpr Span<T> Flat() const
+    {
+        hs_assert(IsContiguous());
+        return Span<T>(items_, width_ * height_);
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr Span2D SubView(uint64 x, uint64 y, uint64 width, uint64 height) const
+    {
+        hs_assert(x + width <= width_ && y + height <= height_);
+        return Span2D(items_ + y * pitch_ + x, width, height, pitch_);
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr uint64 TileCountX(uint64 tileWidth) const
+    {
+        return (width_ + tileWidth - 1) / tileWidth;
+    }
+
+    //------------------------------------------------------------------------------
+    constexpr uint64 TileCountY(uint64 tileHeight) const
+    {
+        return (height_ + tileHeight - 1) / tileHeight;
+    }
+
+    //------------------------------------------------------------------------------
+    // Tile at the given tile coordinates, tiles at the right and bottom edge are clipped
+    constexpr Span2D Tile(uint64 tileX, uint64 tileY, uint64 tileWidth, uint64 tileHeight) const
+    {
+        const uint64 x = tileX * tileWidth;
+        const uint64 y = tileY * tileHeight;
+        hs_assert(x < width_ && y < height_);
+        return SubView(x, y, width_ - x < tileWidth ? width_ - x : tileWidth, height_ - y < tileHeight ? height_ - y : tileHeight);
+    }
+
+    //------------------------------------------------------------------------------
+    // Calls fun(tile, tileOriginX, tileOriginY) for tiles in row major order, working
+    // on a tile at a time keeps the touched rows in cache for kernels reading neighbors
+    template<class TFun>
+    void ForEachTile(uint64 tileWidth, uint64 tileHeight, TFun fun) const
+    {
+        for (uint64 ty = 0; ty < TileCountY(tileHeight); ++ty)
+        {
+            for (uint64 tx = 0; tx < TileCountX(tileWidth); ++tx)
+                fun(Tile(tx, ty, tileWidth, tileHeight), tx * tileWidth, ty * tileHeight);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    operator Span2D<const T>() const
+    {
+        return Span2D<const T>(items_, width_, height_, pitch_);
+    }
+
+private:
+    T* items_{};
+    uint64 width_{};
+    uint64 height_{};
+    uint64 pitch_{};
 };
 
 //------------------------------------------------------------------------------
@@ -76,4 +527,14 @@ constexpr Span<T> MakeSpan(T (&array)[N])
     return Span<T>(array);
 }
 
+//------------------------------------------------------------------------------
+// View of one member of every struct in the span, e.g. MakeFieldSpan(points, &Point::x)
+template<class TStruct, class TField>
+StridedSpan<TField> MakeFieldSpan(Span<TStruct> span, TField TStruct::* field)
+{
+    if (span.IsEmpty())
+        return StridedSpan<TField>(nullptr, 0, sizeof(TStruct));
+    return StridedSpan<TField>(&(span.Data()->*field), span.Count(), sizeof(TStruct));
+}
+
 }
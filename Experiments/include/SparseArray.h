@@ -2,10 +2,17 @@
 
 #include "Types.h"
 #include "ps_Math.h"
+#include "Span.h"
 
 #include <stdlib.h>
 #include <cstring>
 #include <cassert>
+#include <new>
+#include <utility>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
 
 
 /*
@@ -19,7 +26,6 @@ bitMap          bitSum      elements
 */
 
 //-----------------------------------------------------------------------------
-// TODO Add iterators
 template<class Item_t>
 class SparseArray
 {
@@ -45,11 +51,134 @@ public:
     //-----------------------------------------------------------------------------
     ~SparseArray()
     {
+        DestroyItems();
         free(items_);
         free(bitSums_);
         free(bitFields_);
     }
 
+    //-----------------------------------------------------------------------------
+    SparseArray(const SparseArray&) = delete;
+
+    //-----------------------------------------------------------------------------
+    SparseArray& operator=(const SparseArray&) = delete;
+
+    //-----------------------------------------------------------------------------
+    // The moved from array is left empty and usable
+    SparseArray(SparseArray&& other)
+        : SparseArray()
+    {
+        Swap(other);
+    }
+
+    //-----------------------------------------------------------------------------
+    SparseArray& operator=(SparseArray&& other)
+    {
+        if (this != &other)
+        {
+            SparseArray tmp(std::move(other));
+            Swap(tmp);
+        }
+        return *this;
+    }
+
+    //-----------------------------------------------------------------------------
+    uint Count() const
+    {
+        return count_;
+    }
+
+    //-----------------------------------------------------------------------------
+    // Bytes held by the items and the support arrays
+    uint64 GetMemoryUsage() const
+    {
+        return (uint64)capacity_ * sizeof(Item_t) + (uint64)bitSumsCapacity_ * (sizeof(BitSum_t) + sizeof(BitField_t));
+    }
+
+    //-----------------------------------------------------------------------------
+    bool Contains(uint idx) const
+    {
+        uint iMain = idx >> 6;
+        uint iBits = idx & 63;
+
+        if (iMain >= bitSumsCapacity_)
+            return false;
+
+        return (bitFields_[iMain] & ((BitField_t)1 << iBits)) != 0;
+    }
+
+    //-----------------------------------------------------------------------------
+    // Returns nullptr when the index is not present
+    Item_t* Find(uint idx)
+    {
+        return const_cast<Item_t*>(static_cast<const SparseArray*>(this)->Find(idx));
+    }
+
+    //-----------------------------------------------------------------------------
+    const Item_t* Find(uint idx) const
+    {
+        uint iMain = idx >> 6;
+        uint iBits = idx & 63;
+
+        if (iMain >= bitSumsCapacity_)
+            return nullptr;
+
+        BitField_t bitfield = bitFields_[iMain];
+        BitField_t mask = ((BitField_t)1 << iBits);
+        if ((bitfield & mask) == 0)
+            return nullptr;
+
+        return &items_[bitSums_[iMain] + PopCount64(bitfield & (mask - 1))];
+    }
+
+    //-----------------------------------------------------------------------------
+    // Find for many indices at once, out[i] is nullptr when indices[i] is not present.
+    // With AVX2 four ranks are computed at once from gathered bitfields and bit sums.
+    void Lookup(hs::Span<const uint> indices, hs::Span<Item_t*> out)
+    {
+        assert(indices.Count() == out.Count());
+
+        uint64 i = 0;
+#if defined(__AVX2__)
+        const __m256i one = _mm256_set1_epi64x(1);
+        const __m256i bitMask = _mm256_set1_epi64x(63);
+        const __m128i wordCount = _mm_set1_epi32((int)bitSumsCapacity_);
+        const __m256i itemSize = _mm256_set1_epi64x(sizeof(Item_t));
+        const __m256i itemsBase = _mm256_set1_epi64x((long long)(uintptr_t)items_);
+        const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+        const __m256i nibbleCounts = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+
+        for (; i + 4 <= indices.Count(); i += 4)
+        {
+            __m128i idx = _mm_loadu_si128((const __m128i*)(indices.Data() + i));
+            __m128i iMain = _mm_srli_epi32(idx, 6);
+
+            // Lanes past the bitfields don't gather and end up with empty bitfield
+            __m128i inRange = _mm_cmplt_epi32(iMain, wordCount);
+            __m256i bitfield = _mm256_mask_i32gather_epi64(_mm256_setzero_si256(), (const long long*)bitFields_, iMain, _mm256_cvtepi32_epi64(inRange), 8);
+            __m128i bitSum = _mm_mask_i32gather_epi32(_mm_setzero_si128(), (const int*)bitSums_, iMain, inRange, 4);
+
+            __m256i mask = _mm256_sllv_epi64(one, _mm256_and_si256(_mm256_cvtepu32_epi64(idx), bitMask));
+            __m256i present = _mm256_cmpeq_epi64(_mm256_and_si256(bitfield, mask), mask);
+            __m256i below = _mm256_and_si256(bitfield, _mm256_sub_epi64(mask, one));
+
+            // No 64 bit popcount in AVX2, count nibbles by lookup and sum the bytes of each lane
+            __m256i lo = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(below, lowNibble));
+            __m256i hi = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(_mm256_srli_epi16(below, 4), lowNibble));
+            __m256i bitOffset = _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+
+            __m256i rank = _mm256_add_epi64(_mm256_cvtepu32_epi64(bitSum), bitOffset);
+            __m256i item = _mm256_add_epi64(itemsBase, _mm256_mul_epu32(rank, itemSize));
+            _mm256_storeu_si256((__m256i*)(out.Data() + i), _mm256_and_si256(item, present));
+        }
+#endif
+
+        for (; i < indices.Count(); ++i)
+            out[i] = Find(indices[i]);
+    }
+
     //-----------------------------------------------------------------------------
     Item_t& operator[](uint idx)
     {
@@ -70,6 +199,15 @@ public:
 
     //-----------------------------------------------------------------------------
     bool Insert(uint idx, Item_t newItem)
+    {
+        return Emplace(idx, std::move(newItem));
+    }
+
+    //-----------------------------------------------------------------------------
+    // Constructs the item in place, returns false when the index is already present.
+    // Arguments must not reference items of this array, they can move.
+    template<class ...ArgsT>
+    bool Emplace(uint idx, ArgsT&&... args)
     {
         uint iMain = idx >> 6;
         uint iBits = idx & 63;
@@ -102,11 +240,25 @@ public:
         uint bitOffset = PopCount64((*bitfield) & mask);
         uint iItem = offset + bitOffset;
 
-        // Shift all items
-        for (uint i = count_ - 1; i > iItem; --i)
-            items_[i] = items_[i - 1];
+        // Shift all items after iItem by one, count_ already includes the new item
+        Item_t* items = items_;
+        if (iItem == count_ - 1)
+        {
+            new(items + iItem) Item_t(std::forward<ArgsT>(args)...);
+        }
+        else if constexpr (IsTriviallyRelocatable_v<Item_t>)
+        {
+            memmove((void*)(items + iItem + 1), (void*)(items + iItem), sizeof(Item_t) * (count_ - 1 - iItem));
+            new(items + iItem) Item_t(std::forward<ArgsT>(args)...);
+        }
+        else
+        {
+            new(items + count_ - 1) Item_t(std::move(items[count_ - 2]));
+            for (uint i = count_ - 2; i > iItem; --i)
+                items[i] = std::move(items[i - 1]);
 
-        items_[iItem] = newItem;
+            items[iItem] = Item_t(std::forward<ArgsT>(args)...);
+        }
 
         return true;
     }
@@ -117,6 +269,9 @@ public:
         uint iMain = idx >> 6;
         uint iBits = idx & 63;
 
+        if (iMain >= bitSumsCapacity_)
+            return false;
+
         BitField_t* bitfield = &bitFields_[iMain];
 
         BitField_t mask = ((BitField_t)1 << iBits);
@@ -135,15 +290,184 @@ public:
         uint bitOffset = PopCount64((*bitfield) & mask);
         uint iItem = offset + bitOffset;
 
-        // Shift all items
-        for (uint i = iItem; i < count_; ++i)
-            items_[i] = items_[i + 1];
-
-        //TODO call destructor for items_[count_];
+        // Shift all items after iItem back by one, count_ no longer includes the removed item
+        Item_t* items = items_;
+        if constexpr (IsTriviallyRelocatable_v<Item_t>)
+        {
+            items[iItem].~Item_t();
+            memmove((void*)(items + iItem), (void*)(items + iItem + 1), sizeof(Item_t) * (count_ - iItem));
+        }
+        else
+        {
+            for (uint i = iItem; i < count_; ++i)
+                items[i] = std::move(items[i + 1]);
+            items[count_].~Item_t();
+        }
 
         return true;
     }
 
+    //-----------------------------------------------------------------------------
+    // Replaces the content, indices have to be sorted and unique. Builds bitFields_,
+    // bitSums_ and items_ in one linear pass instead of shifting on every insert.
+    void BulkLoad(hs::Span<const uint> indices, hs::Span<const Item_t> items)
+    {
+        assert(indices.Count() == items.Count());
+
+        const uint count = (uint)items.Count();
+        const uint wordCount = count ? (indices[count - 1] >> 6) + 1 : 1;
+
+        Item_t* newItems = (Item_t*)malloc(sizeof(Item_t) * Max(count, 1u << 5));
+        BitField_t* newBitFields = (BitField_t*)malloc(sizeof(BitField_t) * wordCount);
+        memset(newBitFields, 0, sizeof(BitField_t) * wordCount);
+
+        for (uint i = 0; i < count; ++i)
+        {
+            assert((i == 0 || indices[i - 1] < indices[i]) && "Indices have to be sorted and unique");
+            newBitFields[indices[i] >> 6] |= (BitField_t)1 << (indices[i] & 63);
+            new(newItems + i) Item_t(items[i]);
+        }
+
+        SetStorage(newItems, Max(count, 1u << 5), count, newBitFields, wordCount);
+    }
+
+    //-----------------------------------------------------------------------------
+    // Union with other in one pass over both arrays, elements present in both keep
+    // the value from this array. Items of this array are moved, of other copied.
+    void Merge(const SparseArray& other)
+    {
+        if (this == &other)
+            return;
+
+        const uint wordCount = Max(bitSumsCapacity_, other.bitSumsCapacity_);
+        const uint capacity = Max(count_ + other.count_, 1u << 5);
+
+        Item_t* newItems = (Item_t*)malloc(sizeof(Item_t) * capacity);
+        BitField_t* newBitFields = (BitField_t*)malloc(sizeof(BitField_t) * wordCount);
+
+        Item_t* mine = items_;
+        const Item_t* theirs = other.items_;
+        uint count = 0;
+        for (uint i = 0; i < wordCount; ++i)
+        {
+            BitField_t a = i < bitSumsCapacity_ ? bitFields_[i] : 0;
+            BitField_t b = i < other.bitSumsCapacity_ ? other.bitFields_[i] : 0;
+            newBitFields[i] = a | b;
+
+            // Both item arrays are in index order, take the lowest bit of either
+            for (BitField_t bits = a | b; bits; bits &= bits - 1)
+            {
+                BitField_t bit = bits & (0 - bits);
+                if (a & bit)
+                    new(newItems + count++) Item_t(std::move(*mine));
+                else
+                    new(newItems + count++) Item_t(*theirs);
+                mine += (a & bit) != 0;
+                theirs += (b & bit) != 0;
+            }
+        }
+
+        SetStorage(newItems, capacity, count, newBitFields, wordCount);
+    }
+
+    //-----------------------------------------------------------------------------
+    // Iterators, visit the present elements in index order which is also the order
+    // of items_, so iterating is O(set bits) and reads items_ sequentially
+    //-----------------------------------------------------------------------------
+    template<class TItem>
+    struct Entry
+    {
+        uint index_;
+        TItem& value_;
+    };
+
+    //-----------------------------------------------------------------------------
+    template<class TItem>
+    class IteratorBase
+    {
+    public:
+        //-----------------------------------------------------------------------------
+        IteratorBase(const BitField_t* bitFields, uint wordCount, TItem* item)
+            : bitFields_(bitFields)
+            , wordCount_(wordCount)
+            , item_(item)
+        {
+            SkipEmptyWords();
+        }
+
+        //-----------------------------------------------------------------------------
+        Entry<TItem> operator*() const
+        {
+            return Entry<TItem>{ (word_ << 6) + CountTrailingZeros64(bits_), *item_ };
+        }
+
+        //-----------------------------------------------------------------------------
+        IteratorBase& operator++()
+        {
+            bits_ &= bits_ - 1; // Clear the lowest set bit
+            ++item_;
+            if (!bits_)
+            {
+                ++word_;
+                SkipEmptyWords();
+            }
+            return *this;
+        }
+
+        //-----------------------------------------------------------------------------
+        bool operator==(const IteratorBase& other) const
+        {
+            return item_ == other.item_;
+        }
+
+        //-----------------------------------------------------------------------------
+        bool operator!=(const IteratorBase& other) const
+        {
+            return item_ != other.item_;
+        }
+
+    private:
+        const BitField_t* bitFields_;
+        uint wordCount_;
+        uint word_{};
+        BitField_t bits_{};
+        TItem* item_;
+
+        //-----------------------------------------------------------------------------
+        void SkipEmptyWords()
+        {
+            while (word_ < wordCount_ && !(bits_ = bitFields_[word_]))
+                ++word_;
+        }
+    };
+
+    using Iterator = IteratorBase<Item_t>;
+    using ConstIterator = IteratorBase<const Item_t>;
+
+    //-----------------------------------------------------------------------------
+    Iterator begin()
+    {
+        return Iterator(bitFields_, bitSumsCapacity_, items_);
+    }
+
+    //-----------------------------------------------------------------------------
+    Iterator end()
+    {
+        return Iterator(bitFields_, 0, items_ + count_);
+    }
+
+    //-----------------------------------------------------------------------------
+    ConstIterator begin() const
+    {
+        return ConstIterator(bitFields_, bitSumsCapacity_, items_);
+    }
+
+    //-----------------------------------------------------------------------------
+    ConstIterator end() const
+    {
+        return ConstIterator(bitFields_, 0, items_ + count_);
+    }
+
 private:
     Item_t* items_{};
     BitSum_t* bitSums_{};
@@ -154,12 +478,68 @@ private:
     uint bitSumsCapacity_{};
 
     //-----------------------------------------------------------------------------
-    void Realloc()
+    // Takes over new items and bitfields and computes the bit sums for them
+    void SetStorage(Item_t* items, uint capacity, uint count, BitField_t* bitFields, uint wordCount)
     {
-        void* newItems = malloc(sizeof(Item_t) * capacity_);
-        memcpy(newItems, items_, sizeof(Item_t) * count_);
+        DestroyItems();
         free(items_);
-        items_ = (Item_t*)newItems;
+        free(bitSums_);
+        free(bitFields_);
+
+        items_ = items;
+        capacity_ = capacity;
+        count_ = count;
+        bitFields_ = bitFields;
+        bitSumsCapacity_ = wordCount;
+
+        bitSums_ = (BitSum_t*)malloc(sizeof(BitSum_t) * wordCount);
+        BitSum_t sum = 0;
+        for (uint i = 0; i < wordCount; ++i)
+        {
+            bitSums_[i] = sum;
+            sum += PopCount64(bitFields_[i]);
+        }
+    }
+
+    //-----------------------------------------------------------------------------
+    void DestroyItems()
+    {
+        if constexpr (!std::is_trivially_destructible_v<Item_t>)
+        {
+            for (uint i = 0; i < count_; ++i)
+                items_[i].~Item_t();
+        }
+    }
+
+    //-----------------------------------------------------------------------------
+    void Swap(SparseArray& other)
+    {
+        std::swap(items_, other.items_);
+        std::swap(bitSums_, other.bitSums_);
+        std::swap(bitFields_, other.bitFields_);
+        std::swap(count_, other.count_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(bitSumsCapacity_, other.bitSumsCapacity_);
+    }
+
+    //-----------------------------------------------------------------------------
+    void Realloc()
+    {
+        if constexpr (IsTriviallyRelocatable_v<Item_t>)
+        {
+            items_ = (Item_t*)realloc((void*)items_, sizeof(Item_t) * capacity_);
+        }
+        else
+        {
+            Item_t* newItems = (Item_t*)malloc(sizeof(Item_t) * capacity_);
+            for (uint i = 0; i < count_; ++i)
+            {
+                new(newItems + i) Item_t(std::move(items_[i]));
+                items_[i].~Item_t();
+            }
+            free(items_);
+            items_ = newItems;
+        }
     }
 
     //-----------------------------------------------------------------------------
@@ -187,3 +567,7 @@ private:
         bitSumsCapacity_ = newCapacity;
     }
 };
+
+//-----------------------------------------------------------------------------
+template<class Item_t>
+struct IsTriviallyRelocatable<SparseArray<Item_t>> : std::true_type {};
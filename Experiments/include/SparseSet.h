@@ -0,0 +1,307 @@
+#pragma once
+
+#include "Types.h"
+#include "Allocator.h"
+#include "Array.h"
+#include "Span.h"
+
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+namespace hs
+{
+//------------------------------------------------------------------------------
+// Map from generational keys to values with O(1) insert, remove and lookup and
+// values packed densely for iteration (sparse set).
+//
+// A key is an index in the low INDEX_BITS and a generation in the rest. The sparse
+// side maps the index to a position in the dense arrays, it is split into pages of
+// 2^PageBits positions allocated on first use so a few large keys don't need one huge
+// array. Dense positions [0, Count) are the live keys with their values, removed keys
+// stay after them so Create can hand their index out again with the next generation.
+// A stale key of a reused index has an old generation and is not found.
+//
+//  keys        5 2 7 | 3(gen 1)        live | removed
+//  values      e c g
+//  sparse      page 0: [2]=1 [3]=3 [5]=0 [7]=2, other pages not allocated
+template<class Value_t, uint PageBits = 12>
+class SparseSet
+{
+public:
+    using Key_t = uint;
+
+    static constexpr uint INDEX_BITS = 24;
+    static constexpr Key_t INDEX_MASK = ((Key_t)1 << INDEX_BITS) - 1;
+    static constexpr uint PAGE_SIZE = 1 << PageBits;
+
+    //------------------------------------------------------------------------------
+    static constexpr Key_t MakeKey(uint index, uint generation)
+    {
+        return (generation << INDEX_BITS) | index;
+    }
+
+    //------------------------------------------------------------------------------
+    static constexpr uint GetIndex(Key_t key)
+    {
+        return key & INDEX_MASK;
+    }
+
+    //------------------------------------------------------------------------------
+    static constexpr uint GetGeneration(Key_t key)
+    {
+        return key >> INDEX_BITS;
+    }
+
+    //------------------------------------------------------------------------------
+    SparseSet()
+        : SparseSet(GetDefaultAllocator())
+    {
+    }
+
+    //------------------------------------------------------------------------------
+    explicit SparseSet(Allocator* allocator)
+        : allocator_(allocator)
+        , pages_(allocator)
+        , keys_(allocator)
+        , values_(allocator)
+    {
+    }
+
+    //------------------------------------------------------------------------------
+    ~SparseSet()
+    {
+        for (uint* page : pages_)
+        {
+            if (page)
+                allocator_->Free(page, PAGE_SIZE * sizeof(uint));
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    SparseSet(const SparseSet&) = delete;
+
+    //------------------------------------------------------------------------------
+    SparseSet& operator=(const SparseSet&) = delete;
+
+    //------------------------------------------------------------------------------
+    uint Count() const
+    {
+        return count_;
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsEmpty() const
+    {
+        return count_ == 0;
+    }
+
+    //------------------------------------------------------------------------------
+    bool Contains(Key_t key) const
+    {
+        const uint pos = FindPosition(GetIndex(key));
+        return pos < count_ && keys_[pos] == key;
+    }
+
+    //------------------------------------------------------------------------------
+    // Returns nullptr when the key is not present or its generation is stale
+    const Value_t* Find(Key_t key) const
+    {
+        const uint pos = FindPosition(GetIndex(key));
+        if (pos >= count_ || keys_[pos] != key)
+            return nullptr;
+
+        return &values_[pos];
+    }
+
+    //------------------------------------------------------------------------------
+    Value_t* Find(Key_t key)
+    {
+        return const_cast<Value_t*>(static_cast<const SparseSet*>(this)->Find(key));
+    }
+
+    //------------------------------------------------------------------------------
+    Value_t& operator[](Key_t key)
+    {
+        Value_t* value = Find(key);
+        hs_assert(value);
+        return *value;
+    }
+
+    //------------------------------------------------------------------------------
+    const Value_t& operator[](Key_t key) const
+    {
+        const Value_t* value = Find(key);
+        hs_assert(value);
+        return *value;
+    }
+
+    //------------------------------------------------------------------------------
+    // Adds the value under a new key, reusing indices of removed keys with a higher generation
+    Key_t Create(Value_t value)
+    {
+        Key_t key;
+        if (count_ < keys_.Count())
+        {
+            const Key_t removed = keys_[count_];
+            key = MakeKey(GetIndex(removed), GetGeneration(removed) + 1);
+            keys_[count_] = key;
+        }
+        else
+        {
+            // Skip indices which were inserted with explicit keys
+            while (FindPosition(nextIndex_) != ID_NONE)
+                ++nextIndex_;
+
+            hs_assert(nextIndex_ <= INDEX_MASK && "Out of indices");
+            key = MakeKey(nextIndex_++, 0);
+            GetOrAddSlot(GetIndex(key)) = count_;
+            keys_.Add(key);
+        }
+
+        values_.Add(std::move(value));
+        ++count_;
+
+        return key;
+    }
+
+    //------------------------------------------------------------------------------
+    // Adds the value under the given key, fails when a key with the same index is present
+    bool Insert(Key_t key, Value_t value)
+    {
+        const uint index = GetIndex(key);
+        uint& slot = GetOrAddSlot(index);
+
+        if (slot == ID_NONE)
+        {
+            slot = (uint)keys_.Count();
+            keys_.Add(key);
+        }
+        else if (slot < count_)
+        {
+            return false;
+        }
+
+        // Removed keys are past count_, move this one to the front of them
+        MoveToPosition(slot, count_);
+        keys_[count_] = key;
+        values_.Add(std::move(value));
+        ++count_;
+
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    // Moves the last value into the hole, the dense order is not kept
+    bool Remove(Key_t key)
+    {
+        const uint pos = FindPosition(GetIndex(key));
+        if (pos >= count_ || keys_[pos] != key)
+            return false;
+
+        --count_;
+        MoveToPosition(pos, count_);
+        values_.RemoveSwapBack(pos);
+
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    // Removes all values, the indices are reused by Create with the next generation
+    void Clear()
+    {
+        count_ = 0;
+        values_.Clear();
+    }
+
+    //------------------------------------------------------------------------------
+    // Live keys, in the same order as Values
+    Span<const Key_t> Keys() const
+    {
+        return Span<const Key_t>(keys_.Data(), count_);
+    }
+
+    //------------------------------------------------------------------------------
+    Span<Value_t> Values()
+    {
+        return values_.AsSpan();
+    }
+
+    //------------------------------------------------------------------------------
+    Span<const Value_t> Values() const
+    {
+        return Span<const Value_t>(values_.Data(), count_);
+    }
+
+    //------------------------------------------------------------------------------
+    // Calls fun(key, value) for all values in the dense order
+    template<class TFun>
+    void Each(TFun fun)
+    {
+        for (uint i = 0; i < count_; ++i)
+            fun(keys_[i], values_[i]);
+    }
+
+    //------------------------------------------------------------------------------
+    // Bytes held by the structure including the values
+    uint64 GetMemoryUsage() const
+    {
+        uint64 bytes = pages_.Capacity() * sizeof(uint*) + keys_.Capacity() * sizeof(Key_t) + values_.Capacity() * sizeof(Value_t);
+        for (uint64 i = 0; i < pages_.Count(); ++i)
+        {
+            if (pages_[i])
+                bytes += PAGE_SIZE * sizeof(uint);
+        }
+        return bytes;
+    }
+
+private:
+    static constexpr uint ID_NONE = (uint)-1;
+
+    Allocator*      allocator_;
+    Array<uint*>    pages_;
+    Array<Key_t>    keys_;
+    Array<Value_t>  values_;
+    uint            count_{};
+    uint            nextIndex_{};
+
+    //------------------------------------------------------------------------------
+    uint FindPosition(uint index) const
+    {
+        const uint page = index >> PageBits;
+        if (page >= pages_.Count() || !pages_[page])
+            return ID_NONE;
+
+        return pages_[page][index & (PAGE_SIZE - 1)];
+    }
+
+    //------------------------------------------------------------------------------
+    uint& GetOrAddSlot(uint index)
+    {
+        const uint page = index >> PageBits;
+        if (page >= pages_.Count())
+            pages_.Resize(page + 1);
+
+        if (!pages_[page])
+        {
+            pages_[page] = (uint*)allocator_->Allocate(PAGE_SIZE * sizeof(uint), alignof(uint));
+            memset(pages_[page], 0xff, PAGE_SIZE * sizeof(uint));
+        }
+
+        return pages_[page][index & (PAGE_SIZE - 1)];
+    }
+
+    //------------------------------------------------------------------------------
+    // Swaps the keys at two dense positions and fixes their sparse slots, values are up to the caller
+    void MoveToPosition(uint from, uint to)
+    {
+        if (from == to)
+            return;
+
+        std::swap(keys_[from], keys_[to]);
+        GetOrAddSlot(GetIndex(keys_[from])) = from;
+        GetOrAddSlot(GetIndex(keys_[to])) = to;
+    }
+};
+
+}
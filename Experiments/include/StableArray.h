@@ -0,0 +1,309 @@
+#pragma once
+
+#include "Types.h"
+#include "Array.h"
+
+#include <cassert>
+#include <new>
+#include <utility>
+
+namespace hs
+{
+//------------------------------------------------------------------------------
+// Array stored in fixed chunks of 2^ChunkBits elements. Elements never move once
+// added so pointers to them stay valid, growing only allocates a new chunk.
+// Removal is only supported from the back, otherwise elements would have to move.
+template<class T, uint ChunkBits = 6>
+class StableArray
+{
+public:
+    static constexpr uint64 CHUNK_SIZE = (uint64)1 << ChunkBits;
+    static constexpr uint64 CHUNK_MASK = CHUNK_SIZE - 1;
+
+    //------------------------------------------------------------------------------
+    static constexpr uint64 IndexBad()
+    {
+        return (uint64)-1;
+    }
+
+    //------------------------------------------------------------------------------
+    StableArray() = default;
+
+    //------------------------------------------------------------------------------
+    explicit StableArray(Allocator* allocator)
+        : chunks_(allocator)
+    {
+    }
+
+    //------------------------------------------------------------------------------
+    ~StableArray()
+    {
+        Clear();
+        for (uint64 i = 0; i < chunks_.Count(); ++i)
+            FreeChunk(chunks_[i]);
+    }
+
+    //------------------------------------------------------------------------------
+    StableArray(const StableArray&) = delete;
+
+    //------------------------------------------------------------------------------
+    StableArray& operator=(const StableArray&) = delete;
+
+    //------------------------------------------------------------------------------
+    StableArray(StableArray&& other)
+        : chunks_(std::move(other.chunks_))
+        , count_(other.count_)
+    {
+        other.count_ = 0;
+    }
+
+    //------------------------------------------------------------------------------
+    StableArray& operator=(StableArray&& other)
+    {
+        if (this == &other)
+            return *this;
+
+        Clear();
+        for (uint64 i = 0; i < chunks_.Count(); ++i)
+            FreeChunk(chunks_[i]);
+
+        chunks_ = std::move(other.chunks_);
+        count_ = other.count_;
+        other.count_ = 0;
+
+        return *this;
+    }
+
+    //------------------------------------------------------------------------------
+    Allocator* GetAllocator() const
+    {
+        return chunks_.GetAllocator();
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 Count() const
+    {
+        return count_;
+    }
+
+    //------------------------------------------------------------------------------
+    bool IsEmpty() const
+    {
+        return count_ == 0;
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 Capacity() const
+    {
+        return chunks_.Count() << ChunkBits;
+    }
+
+    //------------------------------------------------------------------------------
+    const T& operator[](uint64 index) const
+    {
+        hs_assert(index < count_);
+        return chunks_[index >> ChunkBits][index & CHUNK_MASK];
+    }
+
+    //------------------------------------------------------------------------------
+    T& operator[](uint64 index)
+    {
+        hs_assert(index < count_);
+        return chunks_[index >> ChunkBits][index & CHUNK_MASK];
+    }
+
+    //------------------------------------------------------------------------------
+    template<class ...ArgsT>
+    T& EmplaceBack(ArgsT ...args)
+    {
+        if (count_ == Capacity())
+            chunks_.Add(AllocateChunk());
+
+        T* item = &chunks_[count_ >> ChunkBits][count_ & CHUNK_MASK];
+        new(item) T(std::forward<ArgsT>(args)...);
+        ++count_;
+
+        return *item;
+    }
+
+    //------------------------------------------------------------------------------
+    T& Add(const T& item)
+    {
+        return EmplaceBack(item);
+    }
+
+    //------------------------------------------------------------------------------
+    T& Add(T&& item)
+    {
+        return EmplaceBack(std::move(item));
+    }
+
+    //------------------------------------------------------------------------------
+    void RemoveLast()
+    {
+        hs_assert(count_);
+        Last().~T();
+        --count_;
+    }
+
+    //------------------------------------------------------------------------------
+    // Destroys the elements but keeps the chunks for reuse
+    void Clear()
+    {
+        for (uint64 i = 0; i < count_; ++i)
+            (*this)[i].~T();
+        count_ = 0;
+    }
+
+    //------------------------------------------------------------------------------
+    void Reserve(uint64 capacity)
+    {
+        while (Capacity() < capacity)
+            chunks_.Add(AllocateChunk());
+    }
+
+    //------------------------------------------------------------------------------
+    const T& First() const
+    {
+        hs_assert(count_);
+        return (*this)[0];
+    }
+
+    //------------------------------------------------------------------------------
+    T& First()
+    {
+        hs_assert(count_);
+        return (*this)[0];
+    }
+
+    //------------------------------------------------------------------------------
+    const T& Last() const
+    {
+        hs_assert(count_);
+        return (*this)[count_ - 1];
+    }
+
+    //------------------------------------------------------------------------------
+    T& Last()
+    {
+        hs_assert(count_);
+        return (*this)[count_ - 1];
+    }
+
+    //------------------------------------------------------------------------------
+    uint64 IndexOf(const T& item) const
+    {
+        for (uint64 i = 0; i < count_; ++i)
+        {
+            if ((*this)[i] == item)
+                return i;
+        }
+
+        return IndexBad();
+    }
+
+    //------------------------------------------------------------------------------
+    // Contiguous part of the array, all chunks but the last one are full
+    Span<T> GetChunk(uint64 chunkIndex)
+    {
+        hs_assert(chunkIndex < ChunkCount());
+        const uint64 begin = chunkIndex << ChunkBits;
+        const uint64 count = count_ - begin < CHUNK_SIZE ? count_ - begin : CHUNK_SIZE;
+        return Span<T>(chunks_[chunkIndex], count);
+    }
+
+    //------------------------------------------------------------------------------
+    // Number of chunks holding at least one element
+    uint64 ChunkCount() const
+    {
+        return (count_ + CHUNK_MASK) >> ChunkBits;
+    }
+
+    //------------------------------------------------------------------------------
+    // Iterators
+    //------------------------------------------------------------------------------
+    class Iterator
+    {
+    public:
+        //------------------------------------------------------------------------------
+        Iterator(T* const* chunks, uint64 index, uint64 count)
+            : chunks_(chunks)
+            , index_(index)
+            , count_(count)
+        {
+            if (index_ < count_)
+                item_ = chunks_[index_ >> ChunkBits] + (index_ & CHUNK_MASK);
+        }
+
+        //------------------------------------------------------------------------------
+        T& operator*() const
+        {
+            return *item_;
+        }
+
+        //------------------------------------------------------------------------------
+        T* operator->() const
+        {
+            return item_;
+        }
+
+        //------------------------------------------------------------------------------
+        Iterator& operator++()
+        {
+            ++index_;
+            ++item_;
+            // Jump to the next chunk, never touches chunks past the end
+            if ((index_ & CHUNK_MASK) == 0 && index_ < count_)
+                item_ = chunks_[index_ >> ChunkBits];
+            return *this;
+        }
+
+        //------------------------------------------------------------------------------
+        bool operator==(const Iterator& other) const
+        {
+            return index_ == other.index_;
+        }
+
+        //------------------------------------------------------------------------------
+        bool operator!=(const Iterator& other) const
+        {
+            return index_ != other.index_;
+        }
+
+    private:
+        T* const* chunks_;
+        T* item_{};
+        uint64 index_;
+        uint64 count_;
+    };
+
+    //------------------------------------------------------------------------------
+    Iterator begin()
+    {
+        return Iterator(chunks_.Data(), 0, count_);
+    }
+
+    //------------------------------------------------------------------------------
+    Iterator end()
+    {
+        return Iterator(chunks_.Data(), count_, count_);
+    }
+
+private:
+    Array<T*> chunks_;
+    uint64 count_{};
+
+    //------------------------------------------------------------------------------
+    T* AllocateChunk()
+    {
+        return (T*)GetAllocator()->Allocate(sizeof(T) * CHUNK_SIZE, alignof(T));
+    }
+
+    //------------------------------------------------------------------------------
+    void FreeChunk(T* chunk)
+    {
+        GetAllocator()->Free(chunk, sizeof(T) * CHUNK_SIZE);
+    }
+};
+
+}
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <float.h>
 #include <cassert>
+#include <type_traits>
 
 using byte = uint8_t;
 using uint8 = uint8_t;
@@ -14,3 +15,21 @@ using int16 = int16_t;
 
 #define hs_assert(x) assert(x)
 
+static constexpr uint64 CACHE_LINE_SIZE = 64;
+
+// Promise to the compiler that the pointer is aligned so it can use aligned vector loads
+#if defined(__GNUC__) || defined(__clang__)
+    #define HS_ASSUME_ALIGNED(ptr, alignment) ((std::remove_reference_t<decltype(ptr)>)__builtin_assume_aligned((ptr), (alignment)))
+#else
+    #define HS_ASSUME_ALIGNED(ptr, alignment) (ptr)
+#endif
+
+//------------------------------------------------------------------------------
+// Type can be moved to a different address by memcpy, the original is then treated
+// as destroyed without running its destructor. Specialize for types which own their
+// memory only through pointers (no pointers into themselves).
+template<class T>
+struct IsTriviallyRelocatable : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template<class T>
+inline constexpr bool IsTriviallyRelocatable_v = IsTriviallyRelocatable<T>::value;
@@ -1,5 +1,6 @@
 
 #include "Headers.h"
+#include "Array.h"
 #include "stb/stb_image_write.h"
 
 struct SeedPoint
@@ -26,12 +27,16 @@ float DistSqr(int x1, int y1, int x2, int y2)
     return (float)(Sqr(x1 - x2) + Sqr(y1 - y2));
 }
 
-typedef void (*VoronoiFunc)(const SeedPoint*, uint, uint*, int, int);
+typedef void (*VoronoiFunc)(const SeedPoint*, uint, hs::Span2D<uint>);
 
-void VoronoiNaive(const SeedPoint* seeds, uint seedCount, uint* img, int width, int height)
+void VoronoiNaive(const SeedPoint* seeds, uint seedCount, hs::Span2D<uint> img)
 {
+    const int width = (int)img.Width();
+    const int height = (int)img.Height();
+
     for (int y = 0; y < height; ++y)
     {
+        hs::Span<uint> row = img.Row(y);
         for (int x = 0; x < width; ++x)
         {
             const SeedPoint* closestPoint = NULL;
@@ -49,11 +54,11 @@ void VoronoiNaive(const SeedPoint* seeds, uint seedCount, uint* img, int width,
             if (closestDist <= POINT_DIST)
             {
                 // Highlight the seed point
-                *(img + y * width + x) = (0xffffffff - closestPoint->Color) | 0xff000000;
+                row[x] = (0xffffffff - closestPoint->Color) | 0xff000000;
             }
             else 
             {
-                *(img + y * width + x) = closestPoint->Color;
+                row[x] = closestPoint->Color;
             }
         }
     }
@@ -61,16 +66,20 @@ void VoronoiNaive(const SeedPoint* seeds, uint seedCount, uint* img, int width,
 
 #define OUTPUT_VORONOI_STEPS 1
 
-void VoronoiJumpFloodFill(const SeedPoint* seeds, uint seedCount, uint* img, int width, int height)
+void VoronoiJumpFloodFill(const SeedPoint* seeds, uint seedCount, hs::Span2D<uint> img)
 {
+    const int width = (int)img.Width();
+    const int height = (int)img.Height();
+
     #if OUTPUT_VORONOI_STEPS
-        const uint imgSize = width * height * sizeof(uint);
-        uint* tempImg = (uint*)malloc(imgSize);
+        hs::Array<uint, CACHE_LINE_SIZE> tempImg;
+        tempImg.ResizeUninitialized(width * height);
+        hs::Span2D<uint> tempView(tempImg.Data(), width, height);
     #endif
 
     for (int i = 0; i < seedCount; ++i)
     {
-        *(img + seeds[i].Y * width + seeds[i].X) = i + 1;
+        img(seeds[i].X, seeds[i].Y) = i + 1;
     }
 
     int16 step = (int16)Max(width, height);
@@ -102,8 +111,8 @@ void VoronoiJumpFloodFill(const SeedPoint* seeds, uint seedCount, uint* img, int
         {
             for (int x = 0; x < width; ++x)
             {
-                uint* imBase = (img + y * width + x );
-                if (*imBase == 0)
+                const uint imBase = img(x, y);
+                if (imBase == 0)
                     continue;
 
                 for (int ni = 0; ni < 8; ++ni)
@@ -113,18 +122,18 @@ void VoronoiJumpFloodFill(const SeedPoint* seeds, uint seedCount, uint* img, int
                     if (jumpX < 0 || jumpX >= width || jumpY < 0 || jumpY >= height)
                         continue;
 
-                    uint* im = (img + jumpY * width + jumpX);
-                    if (*im == 0)
+                    uint& im = img(jumpX, jumpY);
+                    if (im == 0)
                     {
-                        *im = *imBase;
+                        im = imBase;
                     }
                     else
                     {
-                        float currentDist   = DistSqr(x, y, seeds[*im - 1].X, seeds[*im - 1].Y);
-                        float newDist       = DistSqr(x, y, seeds[*imBase - 1].X, seeds[*imBase - 1].Y);
+                        float currentDist   = DistSqr(x, y, seeds[im - 1].X, seeds[im - 1].Y);
+                        float newDist       = DistSqr(x, y, seeds[imBase - 1].X, seeds[imBase - 1].Y);
                         if (newDist < currentDist)
                         {
-                            *im = *imBase;
+                            im = imBase;
                         }
                     }
                 }
@@ -132,23 +141,22 @@ void VoronoiJumpFloodFill(const SeedPoint* seeds, uint seedCount, uint* img, int
         }
 
         #if OUTPUT_VORONOI_STEPS
-            memset(tempImg, 0, imgSize);
-
+            // Every pixel is written, the ones without a seed yet black
             for (int y = 0; y < height; ++y)
             {
                 for (int x = 0; x < width; ++x)
                 {
-                    const uint* im = (img + y * width + x );
+                    const uint im = img(x, y);
                     uint color = 0;
-                    if (*im != 0)
-                        color = seeds[*im - 1].Color;
-                    *(tempImg + y * width + x ) = color;
+                    if (im != 0)
+                        color = seeds[im - 1].Color;
+                    tempView(x, y) = color;
                 }
             }
 
             char buff[128];
             sprintf(buff, "c:/tmp/voronoiStep_%05d.png", step);
-            int writeOK = stbi_write_png(buff, width, height, 4, tempImg, sizeof(uint) * width);
+            int writeOK = stbi_write_png(buff, width, height, 4, tempImg.Data(), sizeof(uint) * width);
             if (!writeOK)
                 assert(!"Writing error, ensure that the directory exists");
         #endif
@@ -163,42 +171,37 @@ void VoronoiJumpFloodFill(const SeedPoint* seeds, uint seedCount, uint* img, int
 
     for (int y = 0; y < height; ++y)
     {
+        hs::Span<uint> row = img.Row(y);
         for (int x = 0; x < width; ++x)
         {
-            uint* im = (img + y * width + x );
-            assert(*im);
+            const uint im = row[x];
+            assert(im);
 
-            float dist = DistSqr(x, y, seeds[*im - 1].X, seeds[*im - 1].Y);
+            float dist = DistSqr(x, y, seeds[im - 1].X, seeds[im - 1].Y);
             if (dist <= POINT_DIST)
             {
                 // Highlight the seed point
-                *(img + y * width + x) = (0xffffffff - seeds[*im - 1].Color) | 0xff000000;
+                row[x] = (0xffffffff - seeds[im - 1].Color) | 0xff000000;
             }
             else 
             {
-                *(img + y * width + x) = seeds[*im - 1].Color;
+                row[x] = seeds[im - 1].Color;
             }
         }
     }
-
-    #if OUTPUT_VORONOI_STEPS
-        free(tempImg);
-    #endif
 }
 
 void GenerateVoronoi(const char* file, const SeedPoint* seeds, uint seedCount, uint width, uint height, VoronoiFunc genFunc)
 {
-    const uint imgSize = width * height * sizeof(uint);
-    uint* img = (uint*)malloc(imgSize);
-    memset(img, 0, imgSize);
+    // Zero initialized, the jump flood fill treats 0 as a pixel without a seed yet
+    hs::Array<uint, CACHE_LINE_SIZE> img;
+    img.Resize(width * height);
 
-    genFunc(seeds, seedCount, img, width, height);
+    genFunc(seeds, seedCount, hs::Span2D<uint>(img.Data(), width, height));
 
-    int writeOK = stbi_write_png(file, width, height, 4, img, sizeof(uint) * width);
+    int writeOK = stbi_write_png(file, width, height, 4, img.Data(), sizeof(uint) * width);
     if (!writeOK)
         assert(!"Writing error, ensure that the directory exists");
-
-    free(img);
 }
 
 #undef POINT_DIST
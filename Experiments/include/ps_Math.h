@@ -2,20 +2,42 @@
 
 #include "Types.h"
 
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+// Hardware popcount is used when the target guarantees the instruction, GCC and
+// Clang with -mpopcnt or -march, MSVC with /arch:AVX or newer (every AVX CPU has
+// POPCNT). Can be forced by defining HS_USE_POPCNT.
+#if !defined(HS_USE_POPCNT) && (defined(__POPCNT__) || (defined(_MSC_VER) && defined(_M_X64) && defined(__AVX__)))
+    #define HS_USE_POPCNT 1
+#endif
+
 //-----------------------------------------------------------------------------
 inline uint PopCount(uint x)
 {
+#if defined(HS_USE_POPCNT) && (defined(__GNUC__) || defined(__clang__))
+    return (uint)__builtin_popcount(x);
+#elif defined(HS_USE_POPCNT)
+    return (uint)__popcnt(x);
+#else
     x = x - ((x >> 1) & 0x55555555);
     x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
     x = (x + (x >> 4)) & 0x0F0F0F0F;
     x = x + (x >> 8);
     x = x + (x >> 16);
     return x & 0x0000003F;
+#endif
 }
 
 //-----------------------------------------------------------------------------
 inline uint PopCount64(uint64 x)
 {
+#if defined(HS_USE_POPCNT) && (defined(__GNUC__) || defined(__clang__))
+    return (uint)__builtin_popcountll(x);
+#elif defined(HS_USE_POPCNT)
+    return (uint)__popcnt64(x);
+#else
     x = x - ((x >> 1) & 0x5555555555555555);
     x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
     x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0F;
@@ -23,8 +45,36 @@ inline uint PopCount64(uint64 x)
     x = x + (x >> 16);
     x = x + (x >> 32);
     return x & 0x0000007F;
+#endif
 }
 
+//-----------------------------------------------------------------------------
+// Index of the highest set bit, x must not be 0
+inline uint Log2Floor64(uint64 x)
+{
+    hs_assert(x);
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return (uint)index;
+#else
+    return 63 - (uint)__builtin_clzll(x);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Index of the lowest set bit, x must not be 0
+inline uint CountTrailingZeros64(uint64 x)
+{
+    hs_assert(x);
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (uint)index;
+#else
+    return (uint)__builtin_ctzll(x);
+#endif
+}
 
 //------------------------------------------------------------------------------
 template<class T>
@@ -1,7 +1,19 @@
 #include "SparseArray.h"
+#include "BucketSparseArray.h"
+#include "HierarchicalSparseArray.h"
+#include "SparseSet.h"
 #include "Array.h"
+#include "InlineArray.h"
+#include "StableArray.h"
+#include "SoaArray.h"
+#include "ConcurrentArray.h"
+#include "ConcurrentSparseArray.h"
 
 #include "Heap.h"
+#include "IndexedHeap.h"
+#include "RadixHeap.h"
+#include "BucketQueue.h"
+#include "MultiQueue.h"
 #include "SortedArray.h"
 
 #include "Voronoi.h"
@@ -16,10 +28,29 @@
 
 #include <chrono>
 #include <cstdio>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <vector>
 
 using namespace hs;
 
+template<class TFun>
+float MeasureSeconds(TFun fun)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    fun();
+    auto end = std::chrono::high_resolution_clock::now();
+    return (end - start).count() / (1000.0f * 1000 * 1000);
+}
+
+// 30 random bits, RAND_MAX is only 0x7fff with MSVC
+uint Rand30()
+{
+    return (((uint)rand() << 15) ^ (uint)rand()) & 0x3fffffff;
+}
+
 void SparseArrayTest()
 {
     SparseArray<const char*> a;
@@ -72,10 +103,436 @@ void SparseArrayTest()
     printf("Element at %d is %d %d\n", 223, points[223].x_, points[223].y_);
     printf("Element at %d is %d %d\n", 22, points[22].x_, points[22].y_);
 
+    printf("---- Points iterated ----\n");
+    for (auto [index, point] : points)
+        printf("Element at %d is %d %d\n", index, point.x_, point.y_);
+    printf("Contains %d: %d, contains %d: %d\n", 89, points.Contains(89), 100000, points.Contains(100000));
+
     auto pc = PopCount64((uint64)-1);
     printf("PopCount -1: %ld", pc);
 }
 
+void SparseArrayIterBench()
+{
+    constexpr uint SLOT_COUNT = 1 << 22;
+    constexpr int REPEAT = 10;
+
+    // Percent of the slots which hold an element
+    for (uint density : { 1, 10, 50 })
+    {
+        SparseArray<uint> sa;
+        srand(42);
+        for (uint i = 0; i < SLOT_COUNT; ++i)
+        {
+            if ((uint)(rand() % 100) < density)
+                sa.Insert(i, i);
+        }
+
+        uint64 probeSum = 0;
+        float probe = MeasureSeconds([&]()
+        {
+            for (int r = 0; r < REPEAT; ++r)
+            {
+                for (uint i = 0; i < SLOT_COUNT; ++i)
+                {
+                    if (uint* item = sa.Find(i))
+                        probeSum += *item;
+                }
+            }
+        });
+
+        uint64 iterSum = 0;
+        float iterate = MeasureSeconds([&]()
+        {
+            for (int r = 0; r < REPEAT; ++r)
+            {
+                for (auto [index, item] : sa)
+                    iterSum += item;
+            }
+        });
+
+        printf("Density %2u%%  probing: %f, iterating: %f seconds, chsm: %llu %llu\n",
+            density, probe, iterate, (unsigned long long)probeSum, (unsigned long long)iterSum);
+    }
+}
+
+void BucketSparseArrayBench()
+{
+    // SparseArray shifts all later items on insert, it is only run on the smaller sizes
+    constexpr uint SPARSE_ARRAY_MAX = 100'000;
+
+    for (uint count : { 10'000u, 100'000u, 1'000'000u })
+    {
+        Array<uint> indices;
+        srand(42);
+        for (uint i = 0; i < count; ++i)
+            indices.Add(Rand30() % (count * 4));
+
+        BucketSparseArray<uint> bucket;
+        float bucketBuild = MeasureSeconds([&]()
+        {
+            for (uint idx : indices)
+                bucket.Insert(idx, idx);
+        });
+
+        uint64 bucketSum = 0;
+        float bucketLookup = MeasureSeconds([&]()
+        {
+            for (uint idx : indices)
+                bucketSum += bucket[idx];
+        });
+
+        float sparseBuild = 0;
+        float sparseLookup = 0;
+        uint64 sparseSum = 0;
+        if (count <= SPARSE_ARRAY_MAX)
+        {
+            SparseArray<uint> sparse;
+            sparseBuild = MeasureSeconds([&]()
+            {
+                for (uint idx : indices)
+                    sparse.Insert(idx, idx);
+            });
+
+            sparseLookup = MeasureSeconds([&]()
+            {
+                for (uint idx : indices)
+                    sparseSum += sparse[idx];
+            });
+        }
+
+        printf("%7u items  build SparseArray: %f, Bucket: %f  lookup SparseArray: %f, Bucket: %f seconds, chsm: %llu %llu\n",
+            count, sparseBuild, bucketBuild, sparseLookup, bucketLookup, (unsigned long long)sparseSum, (unsigned long long)bucketSum);
+    }
+}
+
+void SparseArrayBulkBench()
+{
+    constexpr uint COUNT = 1'000'000;
+
+    // Sorted unique indices, every fourth slot on average
+    Array<uint> indices;
+    Array<uint> values;
+    srand(42);
+    for (uint i = 0; i < COUNT * 4; ++i)
+    {
+        if (rand() % 4 == 0)
+        {
+            indices.Add(i);
+            values.Add(i);
+        }
+    }
+
+    SparseArray<uint> inserted;
+    float insert = MeasureSeconds([&]()
+    {
+        for (uint i = 0; i < indices.Count(); ++i)
+            inserted.Insert(indices[i], values[i]);
+    });
+
+    SparseArray<uint> loaded;
+    float bulkLoad = MeasureSeconds([&]()
+    {
+        loaded.BulkLoad(indices.AsSpan(), values.AsSpan());
+    });
+
+    // Union of the loaded array with odd indices, once by inserting and once by merging
+    SparseArray<uint> odd;
+    Array<uint> oddIndices;
+    for (uint i = 1; i < COUNT * 4; i += 2)
+        oddIndices.Add(i);
+    odd.BulkLoad(oddIndices.AsSpan(), oddIndices.AsSpan());
+
+    SparseArray<uint> insertUnion;
+    insertUnion.BulkLoad(indices.AsSpan(), values.AsSpan());
+    float insertMerge = MeasureSeconds([&]()
+    {
+        // Limited, every insert into the middle shifts the rest of the items
+        uint remaining = 2'000;
+        for (auto [index, value] : odd)
+        {
+            insertUnion.Insert(index, value);
+            if (!--remaining)
+                break;
+        }
+    });
+
+    float merge = MeasureSeconds([&]()
+    {
+        loaded.Merge(odd);
+    });
+
+    uint64 checksum = 0;
+    for (auto [index, value] : loaded)
+        checksum += value;
+
+    printf("Build %u items  Insert sorted: %f, BulkLoad: %f seconds\n", (uint)indices.Count(), insert, bulkLoad);
+    printf("Union with %u items  2000 Inserts: %f, Merge: %f seconds, count: %u, chsm: %llu\n",
+        odd.Count(), insertMerge, merge, loaded.Count(), (unsigned long long)checksum);
+}
+
+void SparseArrayLookupBench()
+{
+    constexpr uint SLOT_COUNT = 1 << 22;
+    constexpr uint QUERY_COUNT = 1 << 20;
+    constexpr int REPEAT = 20;
+
+    Array<uint> indices;
+    srand(42);
+    for (uint i = 0; i < SLOT_COUNT; ++i)
+    {
+        if (rand() % 4 == 0)
+            indices.Add(i);
+    }
+
+    SparseArray<uint> sa;
+    sa.BulkLoad(indices.AsSpan(), indices.AsSpan());
+
+    // About a quarter of the queries hit
+    Array<uint> queries;
+    for (uint i = 0; i < QUERY_COUNT; ++i)
+        queries.Add(Rand30() % SLOT_COUNT);
+
+    uint64 scalarSum = 0;
+    float scalar = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            for (uint q : queries)
+            {
+                if (uint* item = sa.Find(q))
+                    scalarSum += *item;
+            }
+        }
+    });
+
+    Array<uint*> found;
+    found.Resize(queries.Count());
+    uint64 batchSum = 0;
+    float batch = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            sa.Lookup(queries.AsSpan(), found.AsSpan());
+            for (uint* item : found)
+            {
+                if (item)
+                    batchSum += *item;
+            }
+        }
+    });
+
+#if defined(HS_USE_POPCNT)
+    const char* popCount = "POPCNT";
+#else
+    const char* popCount = "portable";
+#endif
+#if defined(__AVX2__)
+    const char* lookup = "AVX2";
+#else
+    const char* lookup = "scalar";
+#endif
+    printf("PopCount %s, Lookup %s  Find: %f, Lookup: %f seconds, chsm: %llu %llu\n",
+        popCount, lookup, scalar, batch, (unsigned long long)scalarSum, (unsigned long long)batchSum);
+}
+
+void HierarchicalSparseArrayBench()
+{
+    // Single element far away, SparseArray allocates support arrays for all the slots below it
+    for (uint idx : { 1u << 20, 1u << 26, 1u << 31 })
+    {
+        HierarchicalSparseArray<uint> hierarchical;
+        hierarchical.Insert(idx, idx);
+
+        // Too big to allocate for the highest index, computed from the support array sizes instead
+        uint64 sparseBytes = ((uint64)(idx >> 6) + 1) * (sizeof(uint) + sizeof(uint64));
+        if (idx <= 1u << 26)
+        {
+            SparseArray<uint> sparse;
+            sparse.Insert(idx, idx);
+            sparseBytes = sparse.GetMemoryUsage();
+        }
+
+        printf("Index 2^%u  SparseArray: %llu KB, Hierarchical: %llu KB\n", Log2Floor64(idx),
+            (unsigned long long)sparseBytes / 1024, (unsigned long long)hierarchical.GetMemoryUsage() / 1024);
+    }
+
+    // Random 32 bit keys, only the hierarchical variant can hold them
+    {
+        constexpr uint COUNT = 100'000;
+        HierarchicalSparseArray<uint> hierarchical;
+        srand(42);
+        float build = MeasureSeconds([&]()
+        {
+            for (uint i = 0; i < COUNT; ++i)
+                hierarchical.Insert(((uint)rand() << 17) ^ ((uint)rand() << 2) ^ (uint)rand(), i);
+        });
+
+        printf("%u random 32 bit keys  build: %f seconds, %llu KB\n",
+            COUNT, build, (unsigned long long)hierarchical.GetMemoryUsage() / 1024);
+    }
+
+    // Dense keys where the flat SparseArray is at its best
+    {
+        constexpr uint SLOT_COUNT = 1 << 22;
+        constexpr int REPEAT = 10;
+
+        Array<uint> indices;
+        srand(42);
+        for (uint i = 0; i < SLOT_COUNT; ++i)
+        {
+            if (rand() % 4 == 0)
+                indices.Add(i);
+        }
+
+        SparseArray<uint> sparse;
+        sparse.BulkLoad(indices.AsSpan(), indices.AsSpan());
+        HierarchicalSparseArray<uint> hierarchical;
+        for (uint idx : indices)
+            hierarchical.Insert(idx, idx);
+
+        Array<uint> queries;
+        for (uint i = 0; i < indices.Count(); ++i)
+            queries.Add(indices[Rand30() % indices.Count()]);
+
+        uint64 checksum = 0;
+        float sparseLookup = MeasureSeconds([&]()
+        {
+            for (int r = 0; r < REPEAT; ++r)
+            {
+                for (uint q : queries)
+                    checksum += sparse[q];
+            }
+        });
+
+        float hierarchicalLookup = MeasureSeconds([&]()
+        {
+            for (int r = 0; r < REPEAT; ++r)
+            {
+                for (uint q : queries)
+                    checksum += hierarchical[q];
+            }
+        });
+
+        printf("%u dense keys  lookup SparseArray: %f, Hierarchical: %f seconds, %llu KB vs %llu KB, chsm: %llu\n",
+            (uint)indices.Count(), sparseLookup, hierarchicalLookup, (unsigned long long)sparse.GetMemoryUsage() / 1024,
+            (unsigned long long)hierarchical.GetMemoryUsage() / 1024, (unsigned long long)checksum);
+    }
+}
+
+void SparseSetBench()
+{
+    constexpr uint SLOT_COUNT = 1 << 24;
+    constexpr uint COUNT = 50'000;
+    constexpr int REPEAT = 10;
+
+    Array<uint> keys;
+    srand(42);
+    for (uint i = 0; i < COUNT; ++i)
+        keys.Add(Rand30() % SLOT_COUNT);
+
+    Array<uint> queries;
+    for (uint i = 0; i < COUNT; ++i)
+        queries.Add(keys[Rand30() % COUNT]);
+
+    SparseArray<uint> sparse;
+    SparseSet<uint> set;
+
+    float sparseInsert = MeasureSeconds([&]()
+    {
+        for (uint key : keys)
+            sparse.Insert(key, key);
+    });
+
+    float setInsert = MeasureSeconds([&]()
+    {
+        for (uint key : keys)
+            set.Insert(key, key);
+    });
+
+    uint64 sparseChecksum = 0;
+    float sparseLookup = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            for (uint q : queries)
+                sparseChecksum += sparse[q];
+        }
+    });
+
+    uint64 setChecksum = 0;
+    float setLookup = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            for (uint q : queries)
+                setChecksum += set[q];
+        }
+    });
+
+    float sparseIterate = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            for (auto entry : sparse)
+                sparseChecksum += entry.value_;
+        }
+    });
+
+    float setIterate = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            for (uint value : set.Values())
+                setChecksum += value;
+        }
+    });
+
+    float sparseRemove = MeasureSeconds([&]()
+    {
+        for (uint key : keys)
+            sparse.Remove(key);
+    });
+
+    float setRemove = MeasureSeconds([&]()
+    {
+        for (uint key : keys)
+            set.Remove(key);
+    });
+
+    hs_assert(sparseChecksum == setChecksum && sparse.Count() == 0 && set.Count() == 0);
+
+    printf("%u random keys of 2^24  insert SparseArray: %f, SparseSet: %f, lookup: %f, %f, iterate: %f, %f, remove: %f, %f seconds, chsm: %llu\n",
+        COUNT, sparseInsert, setInsert, sparseLookup, setLookup, sparseIterate, setIterate, sparseRemove, setRemove, (unsigned long long)setChecksum);
+
+    // Entity style use, ids are handed out by the set and recycled
+    {
+        SparseSet<uint> entities;
+        Array<SparseSet<uint>::Key_t> alive;
+        uint64 checksum = 0;
+        float churn = MeasureSeconds([&]()
+        {
+            for (uint i = 0; i < COUNT * REPEAT; ++i)
+            {
+                if (alive.Count() < COUNT / 2 || rand() % 2)
+                {
+                    alive.Add(entities.Create(i));
+                }
+                else
+                {
+                    const uint victim = (uint)rand() % alive.Count();
+                    checksum += entities[alive[victim]];
+                    entities.Remove(alive[victim]);
+                    alive.RemoveSwapBack(victim);
+                }
+            }
+        });
+
+        printf("SparseSet create/remove churn  %f seconds, %u alive, %llu KB, chsm: %llu\n",
+            churn, entities.Count(), (unsigned long long)entities.GetMemoryUsage() / 1024, (unsigned long long)checksum);
+    }
+}
+
 void ArrayTest()
 {
     Array<int> a;
@@ -113,6 +570,122 @@ void ArrayTest()
     }
 }
 
+void InlineArrayTest()
+{
+    TrackingAllocator tracking;
+    InlineArray<int, 4> a(&tracking);
+
+    for (int i = 0; i < 4; ++i)
+        a.Add(i);
+
+    printf("--- InlineArray with %llu items, inline: %d, allocations: %llu\n",
+        (unsigned long long)a.Count(), a.IsInline(), (unsigned long long)tracking.GetAllocationCount());
+
+    a.Insert(2, 999);
+    a.Remove(0);
+
+    printf("--- InlineArray with %llu items, inline: %d, allocations: %llu\n",
+        (unsigned long long)a.Count(), a.IsInline(), (unsigned long long)tracking.GetAllocationCount());
+    for (int i = 0; i < a.Count(); ++i)
+    {
+        printf("\tArr[%d] == %d\n", i, a[i]);
+    }
+}
+
+void SpanSplitTest()
+{
+    Array<uint> a;
+    a.Resize(1003);
+
+    // Start the view off a cache line boundary so the first piece absorbs the head
+    Span<uint> items = a.AsSpan().Subspan(3);
+
+    for (uint threadCount = 1; threadCount <= 8; ++threadCount)
+    {
+        SpanChunks<uint> pieces = items.SplitForThreads(threadCount);
+
+        std::vector<std::thread> threads;
+        for (Span<uint> piece : pieces)
+        {
+            threads.emplace_back([piece, threadCount]()
+            {
+                for (uint& item : piece)
+                    item += threadCount;
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        printf("--- %u threads, %llu pieces:", threadCount, (unsigned long long)pieces.Count());
+        for (uint64 i = 0; i < pieces.Count(); ++i)
+        {
+            Span<uint> piece = pieces[i];
+            const bool aligned = i == 0 || (uintptr_t)piece.Data() % CACHE_LINE_SIZE == 0;
+            printf(" [%llu, %llu)%s", (unsigned long long)(piece.Data() - items.Data()),
+                (unsigned long long)(piece.Data() - items.Data() + piece.Count()), aligned ? "" : " unaligned!");
+        }
+        printf("\n");
+    }
+
+    // Every element got each thread count exactly once
+    uint64 wrong = 0;
+    for (uint item : items)
+        wrong += item != 36;
+    printf("--- Wrong items: %llu, untouched head: %u %u %u\n", (unsigned long long)wrong, a[0], a[1], a[2]);
+}
+
+void Span2DTest()
+{
+    constexpr uint64 WIDTH = 10;
+    constexpr uint64 HEIGHT = 7;
+    constexpr uint64 PITCH = 16;
+
+    // Image inside a wider buffer, the padding of every row has to stay untouched
+    Array<uint> buffer;
+    buffer.Resize(PITCH * HEIGHT);
+    Span2D<uint> img(buffer.Data(), WIDTH, HEIGHT, PITCH);
+
+    // 4x3 tiles, the last column and row of tiles are clipped
+    uint tileIndex = 0;
+    uint64 tilePixels = 0;
+    img.ForEachTile(4, 3, [&](Span2D<uint> tile, uint64 originX, uint64 originY)
+    {
+        printf("--- Tile %u at [%llu, %llu] %llux%llu\n", tileIndex, (unsigned long long)originX, (unsigned long long)originY,
+            (unsigned long long)tile.Width(), (unsigned long long)tile.Height());
+        for (uint64 y = 0; y < tile.Height(); ++y)
+            for (uint& pixel : tile.Row(y))
+                pixel = tileIndex;
+        tilePixels += tile.Width() * tile.Height();
+        ++tileIndex;
+    });
+
+    uint64 wrong = 0;
+    for (uint64 y = 0; y < HEIGHT; ++y)
+    {
+        for (uint64 x = 0; x < WIDTH; ++x)
+            wrong += img(x, y) != (y / 3) * img.TileCountX(4) + x / 4;
+        for (uint64 x = WIDTH; x < PITCH; ++x)
+            wrong += buffer[y * PITCH + x] != 0;
+    }
+    printf("--- Tiles: %u, pixels: %llu, wrong: %llu\n", tileIndex, (unsigned long long)tilePixels, (unsigned long long)wrong);
+
+    // Sub view shares the pitch, its columns are strided spans
+    Span2D<uint> sub = img.SubView(2, 1, 5, 4);
+    uint64 columnSum = 0;
+    for (uint pixel : sub.Column(3))
+        columnSum += pixel;
+    printf("--- SubView contiguous: %d, image contiguous: %d, column 3 sum: %llu\n",
+        sub.IsContiguous(), Span2D<uint>(buffer.Data(), PITCH, HEIGHT).IsContiguous(), (unsigned long long)columnSum);
+
+    // One field of an array of structs
+    SeedPoint seeds[] = { { 1, 10, 0xff }, { 2, 20, 0xff }, { 3, 30, 0xff } };
+    StridedSpan<int16> ys = MakeFieldSpan(MakeSpan(seeds), &SeedPoint::Y);
+    int ySum = 0;
+    for (int16 y : ys)
+        ySum += y;
+    printf("--- Seed Y sum: %d, stride: %llu\n", ySum, (unsigned long long)ys.Stride());
+}
+
 void HeapVsSortedArrayBench()
 {
     constexpr int ITER = 1'00'000;
@@ -143,51 +716,501 @@ void HeapVsSortedArrayBench()
 
     {
         int checksum = 0;
-        Heap sa;
+        Heap<int> heap;
         srand(42);
 
         auto start = std::chrono::high_resolution_clock::now();
         for (int i = 0; i < ITER; ++i)
         {
             bool remove = (rand() % 3) == 0;
-            if (sa.Count() && remove)
+            if (heap.Count() && remove)
             {
-                checksum += sa.RemoveMin();
+                checksum += heap.RemoveTop();
             }
             else
             {
-                sa.Add(rand());
+                heap.Add(rand());
             }
         }
         auto end = std::chrono::high_resolution_clock::now();
         auto elapsed = (end - start).count() / (1000.0f * 1000 * 1000);
 
-        printf("SortedArray chsm: %d, elapsed: %f seconds\n", checksum, elapsed);
+        printf("Heap chsm: %d, elapsed: %f seconds\n", checksum, elapsed);
     }
-}
 
-void VoronoiTest()
-{
-    constexpr uint seedCount = 5;
-    SeedPoint seeds[seedCount];
-    seeds[0] = SeedPoint{ 100, 100, 0xffff0000 };
-    seeds[1] = SeedPoint{ 800, 800, 0xff00ff00 };
-    seeds[2] = SeedPoint{ 456, 120, 0xff0000ff };
-    seeds[3] = SeedPoint{ 500, 500, 0xff00ffff };
-    seeds[4] = SeedPoint{ 100, 700, 0xffff00ff };
+    // Same mix of operations with growing heaps, the sorted array is quadratic so only heaps go on.
+    // Operations are generated up front so rand doesn't dominate, -1 removes the top.
+    auto runHeap = [](auto& heap, Span<const int> ops, auto makeKey)
+    {
+        int64_t checksum = 0;
+        float elapsed = MeasureSeconds([&]()
+        {
+            for (int op : ops)
+            {
+                if (op < 0)
+                {
+                    if (heap.Count())
+                        checksum += (int64_t)heap.RemoveTop();
+                }
+                else
+                {
+                    heap.Add(makeKey(op));
+                }
+            }
+        });
+        return std::make_pair(elapsed, checksum);
+    };
 
-    const char* naiveFile = "c:/tmp/voronoiNaive.png";
-    const char* jffFile = "c:/tmp/voronoiJFF.png";
+    for (int iter : { 100'000, 1'000'000, 10'000'000 })
+    {
+        Array<int> ops;
+        ops.Reserve(iter);
+        srand(42);
+        for (int i = 0; i < iter; ++i)
+            ops.Add((rand() % 3) == 0 ? -1 : (int)Rand30());
+
+        auto intKey = [](int r) { return r; };
+        Heap<int> binary;
+        Heap<int, std::less<int>, 4> quaternary;
+        Heap<int, std::less<int>, 8> octonary;
+        auto [binaryTime, binarySum] = runHeap(binary, ops.AsSpan(), intKey);
+        auto [quaternaryTime, quaternarySum] = runHeap(quaternary, ops.AsSpan(), intKey);
+        auto [octonaryTime, octonarySum] = runHeap(octonary, ops.AsSpan(), intKey);
+        hs_assert(binarySum == quaternarySum && binarySum == octonarySum);
+
+        auto floatKey = [](int r) { return (float)r; };
+        Heap<float> binaryFloat;
+        Heap<float, std::less<float>, 4> quaternaryFloat;
+        Heap<float, std::less<float>, 8> octonaryFloat;
+        float binaryFloatTime = runHeap(binaryFloat, ops.AsSpan(), floatKey).first;
+        float quaternaryFloatTime = runHeap(quaternaryFloat, ops.AsSpan(), floatKey).first;
+        float octonaryFloatTime = runHeap(octonaryFloat, ops.AsSpan(), floatKey).first;
+
+        printf("%8d ops  int binary: %f, 4-ary: %f, 8-ary: %f  float binary: %f, 4-ary: %f, 8-ary: %f seconds, chsm: %lld\n",
+            iter, binaryTime, quaternaryTime, octonaryTime, binaryFloatTime, quaternaryFloatTime, octonaryFloatTime, (long long)binarySum);
+    }
 
-    GenerateVoronoi(naiveFile, seeds, seedCount, 1024, 1024, &VoronoiNaive);
-    GenerateVoronoi(jffFile, seeds, seedCount, 1024, 1024, &VoronoiJumpFloodFill);
+    // Monotone keys, every added key is the last removed one plus up to 1000 like timers
+    // or Dijkstra distances. Operations hold the delta, -1 removes the top.
+    auto runMonotone = [](Span<const int> ops, auto add, auto removeTop, auto count)
+    {
+        int64_t checksum = 0;
+        uint last = 0;
+        float elapsed = MeasureSeconds([&]()
+        {
+            for (int op : ops)
+            {
+                if (op < 0)
+                {
+                    if (count())
+                    {
+                        last = removeTop();
+                        checksum += last;
+                    }
+                }
+                else
+                {
+                    add(last + (uint)op);
+                }
+            }
+        });
+        return std::make_pair(elapsed, checksum);
+    };
+
+    for (int iter : { 100'000, 1'000'000, 10'000'000 })
+    {
+        Array<int> ops;
+        ops.Reserve(iter);
+        srand(42);
+        for (int i = 0; i < iter; ++i)
+            ops.Add((rand() % 3) == 0 ? -1 : rand() % 1000);
+
+        Heap<uint> binary;
+        auto [binaryTime, binarySum] = runMonotone(ops.AsSpan(),
+            [&](uint key) { binary.Add(key); },
+            [&]() { return binary.RemoveTop(); },
+            [&]() { return binary.Count(); });
+
+        Heap<uint, std::less<uint>, 4> quaternary;
+        auto [quaternaryTime, quaternarySum] = runMonotone(ops.AsSpan(),
+            [&](uint key) { quaternary.Add(key); },
+            [&]() { return quaternary.RemoveTop(); },
+            [&]() { return quaternary.Count(); });
+
+        RadixHeap<uint> radix;
+        auto [radixTime, radixSum] = runMonotone(ops.AsSpan(),
+            [&](uint key) { radix.Add(key, key); },
+            [&]() { return radix.RemoveTop().key_; },
+            [&]() { return radix.Count(); });
+
+        // Keys never get more than 1000 ahead so a ring of 1024 single key buckets never wraps onto itself
+        BucketQueue<uint> buckets(1024, 1);
+        auto [bucketTime, bucketSum] = runMonotone(ops.AsSpan(),
+            [&](uint key) { buckets.Add(key, key); },
+            [&]() { return buckets.RemoveTop().key_; },
+            [&]() { return buckets.Count(); });
+
+        hs_assert(binarySum == quaternarySum && binarySum == radixSum && binarySum == bucketSum);
+
+        printf("%8d monotone ops  binary: %f, 4-ary: %f, RadixHeap: %f, BucketQueue: %f seconds, chsm: %lld\n",
+            iter, binaryTime, quaternaryTime, radixTime, bucketTime, (long long)binarySum);
+    }
 }
 
-struct Position
+void MultiQueueBench()
 {
-    int x;
-    int y;
-};
+    constexpr uint PREFILL = 100'000;
+    constexpr uint OPS_PER_THREAD = 1'000'000;
+    constexpr uint RANK_KEYS = 1'000'000;
+    constexpr uint QUEUES_PER_THREAD = 4;
+    const uint maxThreads = Max<uint>(std::thread::hardware_concurrency(), 1);
+
+    auto runThreads = [](uint threadCount, auto fun)
+    {
+        std::vector<std::thread> threads;
+        for (uint t = 0; t < threadCount; ++t)
+            threads.emplace_back([=]() { fun(t); });
+        for (auto& thread : threads)
+            thread.join();
+    };
+
+    for (uint threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+    {
+        const uint queueCount = Max(threadCount * QUEUES_PER_THREAD, 2u);
+
+        // Throughput, every thread alternates adding a random key and removing the top
+        Heap<uint64> lockedHeap;
+        std::mutex mutex;
+        srand(42);
+        for (uint i = 0; i < PREFILL; ++i)
+            lockedHeap.Add((uint64)rand());
+
+        float lockedTime = MeasureSeconds([&]()
+        {
+            runThreads(threadCount, [&](uint t)
+            {
+                uint64 key = t + 1;
+                for (uint i = 0; i < OPS_PER_THREAD; ++i)
+                {
+                    key = key * 6364136223846793005ull + 1442695040888963407ull;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (i & 1)
+                        lockedHeap.RemoveTop();
+                    else
+                        lockedHeap.Add(key >> 33);
+                }
+            });
+        });
+
+        MultiQueue<uint> multiQueue(queueCount);
+        for (uint i = 0; i < PREFILL; ++i)
+            multiQueue.Add((uint64)rand(), i);
+
+        float multiTime = MeasureSeconds([&]()
+        {
+            runThreads(threadCount, [&](uint t)
+            {
+                uint64 key = t + 1;
+                MultiQueue<uint>::Entry entry;
+                for (uint i = 0; i < OPS_PER_THREAD; ++i)
+                {
+                    key = key * 6364136223846793005ull + 1442695040888963407ull;
+                    if (i & 1)
+                        multiQueue.TryRemoveTop(entry);
+                    else
+                        multiQueue.Add(key >> 33, i);
+                }
+            });
+        });
+
+        // Rank error, all threads drain a queue of distinct keys and record the order of the pops,
+        // the error of a pop is the number of lower keys still in the queue at that moment
+        MultiQueue<uint> rankQueue(queueCount);
+        {
+            Array<uint> keys;
+            for (uint i = 0; i < RANK_KEYS; ++i)
+                keys.Add(i);
+            for (uint i = RANK_KEYS - 1; i > 0; --i)
+                std::swap(keys[i], keys[Rand30() % (i + 1)]);
+            for (uint key : keys)
+                rankQueue.Add(key, key);
+        }
+
+        Array<uint> popOrder;
+        popOrder.ResizeUninitialized(RANK_KEYS);
+        std::atomic<uint> popCount{};
+        runThreads(threadCount, [&](uint)
+        {
+            MultiQueue<uint>::Entry entry;
+            while (rankQueue.TryRemoveTop(entry))
+                popOrder[popCount++] = (uint)entry.key_;
+        });
+        hs_assert(popCount == RANK_KEYS);
+
+        // Fenwick tree over the keys still present
+        Array<uint> present;
+        present.Resize(RANK_KEYS + 1);
+        for (uint i = 1; i <= RANK_KEYS; ++i)
+        {
+            present[i] += 1;
+            const uint parent = i + (i & (0 - i));
+            if (parent <= RANK_KEYS)
+                present[parent] += present[i];
+        }
+
+        uint64 rankErrorSum = 0;
+        uint maxRankError = 0;
+        for (uint key : popOrder)
+        {
+            uint lower = 0;
+            for (uint i = key; i > 0; i -= i & (0 - i))
+                lower += present[i];
+            for (uint i = key + 1; i <= RANK_KEYS; i += i & (0 - i))
+                present[i] -= 1;
+
+            rankErrorSum += lower;
+            maxRankError = Max(maxRankError, lower);
+        }
+
+        const float totalOps = (float)threadCount * OPS_PER_THREAD;
+        printf("Threads %2u, %3u queues  mutex Heap: %.1f Mops/s, MultiQueue: %.1f Mops/s, rank error mean: %.2f, max: %u\n",
+            threadCount, queueCount, totalOps / lockedTime / 1e6f, totalOps / multiTime / 1e6f,
+            (float)rankErrorSum / RANK_KEYS, maxRankError);
+    }
+}
+
+void HeapBench()
+{
+    constexpr uint COUNT = 1'000'000;
+    constexpr uint TOP_K = 1'000;
+
+    // Counts comparisons so the fused operations can be compared independent of timing noise
+    static uint64 comparisons = 0;
+    struct CountingLess
+    {
+        bool operator()(int a, int b) const
+        {
+            ++comparisons;
+            return a < b;
+        }
+    };
+
+    Array<int> values;
+    srand(42);
+    for (uint i = 0; i < COUNT; ++i)
+        values.Add((int)Rand30());
+
+    {
+        comparisons = 0;
+        Heap<int, CountingLess> added;
+        float addTime = MeasureSeconds([&]()
+        {
+            for (int v : values)
+                added.Add(v);
+        });
+        const uint64 addComparisons = comparisons;
+
+        comparisons = 0;
+        Heap<int, CountingLess> heapified;
+        float heapifyTime = MeasureSeconds([&]()
+        {
+            heapified = Heap<int, CountingLess>(values.AsSpan());
+        });
+        const uint64 heapifyComparisons = comparisons;
+
+        // Both have to pop the same sequence
+        uint mismatches = 0;
+        while (added.Count())
+            mismatches += added.RemoveTop() != heapified.RemoveTop();
+
+        printf("Build %u  Add: %f s, %llu cmp, heapify: %f s, %llu cmp, mismatches: %u\n", COUNT,
+            addTime, (unsigned long long)addComparisons, heapifyTime, (unsigned long long)heapifyComparisons, mismatches);
+    }
+
+    // Keep the largest TOP_K values of a stream in a min heap
+    {
+        Heap<int, CountingLess> separate;
+        comparisons = 0;
+        float separateTime = MeasureSeconds([&]()
+        {
+            for (int v : values)
+            {
+                separate.Add(v);
+                if (separate.Count() > TOP_K)
+                    separate.RemoveTop();
+            }
+        });
+        const uint64 separateComparisons = comparisons;
+
+        Heap<int, CountingLess> fused;
+        comparisons = 0;
+        float fusedTime = MeasureSeconds([&]()
+        {
+            for (int v : values)
+            {
+                if (fused.Count() < TOP_K)
+                    fused.Add(v);
+                else
+                    fused.PushPop(v);
+            }
+        });
+        const uint64 fusedComparisons = comparisons;
+
+        uint mismatches = 0;
+        while (fused.Count())
+            mismatches += fused.RemoveTop() != separate.RemoveTop();
+
+        printf("Top %u of %u  Add + RemoveTop: %f s, %llu cmp, PushPop: %f s, %llu cmp, mismatches: %u\n", TOP_K, COUNT,
+            separateTime, (unsigned long long)separateComparisons, fusedTime, (unsigned long long)fusedComparisons, mismatches);
+    }
+}
+
+void DijkstraBench()
+{
+    constexpr uint WIDTH = 1000;
+    constexpr uint HEIGHT = 1000;
+    constexpr uint NODE_COUNT = WIDTH * HEIGHT;
+    constexpr uint DIST_INF = (uint)-1;
+
+    // 4 connected grid with random undirected edge weights, with node weights the first
+    // relaxation of a node would already be final and nothing would ever be decreased
+    Array<uint> rightWeights;
+    Array<uint> downWeights;
+    srand(42);
+    for (uint i = 0; i < NODE_COUNT; ++i)
+    {
+        rightWeights.Add(1 + rand() % 100);
+        downWeights.Add(1 + rand() % 100);
+    }
+
+    auto forNeighbors = [&](uint node, auto fun)
+    {
+        const uint x = node % WIDTH;
+        const uint y = node / WIDTH;
+        if (x > 0) fun(node - 1, rightWeights[node - 1]);
+        if (x + 1 < WIDTH) fun(node + 1, rightWeights[node]);
+        if (y > 0) fun(node - WIDTH, downWeights[node - WIDTH]);
+        if (y + 1 < HEIGHT) fun(node + WIDTH, downWeights[node]);
+    };
+
+    // Same node can be queued many times, stale entries are skipped when popped
+    struct QueueEntry
+    {
+        uint dist_;
+        uint node_;
+
+        bool operator<(const QueueEntry& other) const
+        {
+            return dist_ < other.dist_;
+        }
+    };
+
+    Array<uint> lazyDist;
+    uint64 lazyPushes = 0;
+    uint64 lazyMaxQueue = 0;
+    float lazyTime = MeasureSeconds([&]()
+    {
+        lazyDist.ResizeUninitialized(NODE_COUNT);
+        for (uint& d : lazyDist)
+            d = DIST_INF;
+
+        Heap<QueueEntry> queue;
+        lazyDist[0] = 0;
+        queue.Add({ 0, 0 });
+        while (queue.Count())
+        {
+            lazyMaxQueue = Max<uint64>(lazyMaxQueue, queue.Count());
+            const QueueEntry entry = queue.RemoveTop();
+            if (entry.dist_ != lazyDist[entry.node_])
+                continue;
+
+            forNeighbors(entry.node_, [&](uint next, uint weight)
+            {
+                const uint dist = entry.dist_ + weight;
+                if (dist < lazyDist[next])
+                {
+                    lazyDist[next] = dist;
+                    queue.Add({ dist, next });
+                    ++lazyPushes;
+                }
+            });
+        }
+    });
+
+    Array<uint> indexedDist;
+    uint64 decreases = 0;
+    uint64 indexedMaxQueue = 0;
+    float indexedTime = MeasureSeconds([&]()
+    {
+        indexedDist.ResizeUninitialized(NODE_COUNT);
+        for (uint& d : indexedDist)
+            d = DIST_INF;
+
+        IndexedHeap<uint> queue;
+        queue.Reserve(NODE_COUNT);
+        indexedDist[0] = 0;
+        queue.Add(0, 0);
+        while (queue.Count())
+        {
+            indexedMaxQueue = Max<uint64>(indexedMaxQueue, queue.Count());
+            const uint node = queue.RemoveTop();
+
+            forNeighbors(node, [&](uint next, uint weight)
+            {
+                const uint dist = indexedDist[node] + weight;
+                if (dist < indexedDist[next])
+                {
+                    if (queue.Contains(next))
+                    {
+                        queue.DecreaseKey(next, dist);
+                        ++decreases;
+                    }
+                    else
+                    {
+                        queue.Add(next, dist);
+                    }
+                    indexedDist[next] = dist;
+                }
+            });
+        }
+    });
+
+    uint64 lazySum = 0;
+    uint64 indexedSum = 0;
+    for (uint i = 0; i < NODE_COUNT; ++i)
+    {
+        lazySum += lazyDist[i];
+        indexedSum += indexedDist[i];
+    }
+    hs_assert(lazySum == indexedSum);
+
+    printf("Dijkstra %ux%u  lazy Heap: %f s, %llu pushes, max queue %llu  IndexedHeap: %f s, %llu decreases, max queue %llu, chsm: %llu\n",
+        WIDTH, HEIGHT, lazyTime, (unsigned long long)lazyPushes, (unsigned long long)lazyMaxQueue,
+        indexedTime, (unsigned long long)decreases, (unsigned long long)indexedMaxQueue, (unsigned long long)indexedSum);
+}
+
+void VoronoiTest()
+{
+    constexpr uint seedCount = 5;
+    SeedPoint seeds[seedCount];
+    seeds[0] = SeedPoint{ 100, 100, 0xffff0000 };
+    seeds[1] = SeedPoint{ 800, 800, 0xff00ff00 };
+    seeds[2] = SeedPoint{ 456, 120, 0xff0000ff };
+    seeds[3] = SeedPoint{ 500, 500, 0xff00ffff };
+    seeds[4] = SeedPoint{ 100, 700, 0xffff00ff };
+
+    const char* naiveFile = "c:/tmp/voronoiNaive.png";
+    const char* jffFile = "c:/tmp/voronoiJFF.png";
+
+    GenerateVoronoi(naiveFile, seeds, seedCount, 1024, 1024, &VoronoiNaive);
+    GenerateVoronoi(jffFile, seeds, seedCount, 1024, 1024, &VoronoiJumpFloodFill);
+}
+
+struct Position
+{
+    int x;
+    int y;
+};
 
 struct Velocity
 {
@@ -195,20 +1218,35 @@ struct Velocity
     float y;
 };
 
-void EcsTest()
+void EnsureEcsTypes()
 {
     using namespace archetypeECS;
 
+    static bool initialized = false;
+    if (initialized)
+        return;
+
     TypeInfo<Entity_t>::InitTypeId();
+    TypeInfo<Position>::InitTypeId();
+    TypeInfo<Velocity>::InitTypeId();
+    initialized = true;
+}
+
+void EcsTest()
+{
+    using namespace archetypeECS;
+
+    EnsureEcsTypes();
 
     EcsWorld world;
 
     constexpr uint ENT_COUNT = 8;
     Array<Entity_t> entities;
 
+    Span<Entity_t> created = entities.AppendDefault(ENT_COUNT);
     for (int i = 0; i < ENT_COUNT; ++i)
     {
-        entities.Add(world.CreteEntity());
+        created[i] = world.CreteEntity();
     }
 
     world.DeleteEntity(entities[5]);
@@ -223,17 +1261,11 @@ void EcsTest()
     world.DeleteEntity(entities[3]);
     entities.Remove(3);
 
-    uint *ent, entCount;
-    world.GetEntities(ent, entCount);
-
-    for (int i = 0; i < entCount; ++i)
+    for (Entity_t eid : world.GetEntities())
     {
-        printf("%d\n", ent[i]);
+        printf("%d\n", eid);
     }
 
-    TypeInfo<Position>::InitTypeId();
-    TypeInfo<Velocity>::InitTypeId();
-
     printf("\nEntities:\n");
 
     EcsWorld::Iter<Entity_t> it(&world);
@@ -283,6 +1315,765 @@ void EcsTest()
     int x = 0;
 }
 
+void AllocatorBench()
+{
+    using namespace archetypeECS;
+
+    EnsureEcsTypes();
+
+    constexpr int FRAMES = 1000;
+    constexpr int HEAP_COUNT = 100;
+    constexpr int HEAP_ITEMS = 20;
+    constexpr int ENT_COUNT = 500;
+
+    // Generated up front so the frames time the containers and not rand
+    Array<int> keys;
+    keys.ResizeUninitialized(HEAP_COUNT * HEAP_ITEMS);
+    srand(42);
+    for (int& key : keys)
+        key = (int)Rand30();
+
+    // Simulates frame-local containers, many small ones thrown away at the end of the frame
+    auto heapFrame = [&keys](Allocator* allocator)
+    {
+        uint64 checksum = 0;
+        for (int h = 0; h < HEAP_COUNT; ++h)
+        {
+            Heap<int> heap(allocator);
+            heap.Reserve(HEAP_ITEMS);
+            for (int i = 0; i < HEAP_ITEMS; ++i)
+                heap.Add(keys[h * HEAP_ITEMS + i]);
+            while (heap.Count())
+                checksum += heap.RemoveTop();
+        }
+        return checksum;
+    };
+
+    auto ecsFrame = [](Allocator* allocator)
+    {
+        uint64 checksum = 0;
+        EcsWorld world(allocator);
+        Array<Entity_t> entities(allocator);
+        for (int i = 0; i < ENT_COUNT; ++i)
+        {
+            entities.Add(world.CreteEntity());
+            if (i & 1)
+                world.SetComponents(entities.Last(), Position{ i, i });
+            else
+                world.SetComponents(entities.Last(), Position{ i, i }, Velocity{ 1.0f, 2.0f });
+        }
+
+        EcsWorld::Iter<const Position> it(&world);
+        it.Each([&checksum](const Position& pos)
+        {
+            checksum += pos.x;
+        });
+        return checksum;
+    };
+
+    auto runFrames = [](const char* name, auto frame, Allocator* allocator, LinearAllocator* frameArena)
+    {
+        uint64 checksum = 0;
+        float elapsed = MeasureSeconds([&]()
+        {
+            for (int f = 0; f < FRAMES; ++f)
+            {
+                checksum += frame(allocator);
+                if (frameArena)
+                    frameArena->Reset();
+            }
+        });
+        printf("%-24s chsm: %llu, elapsed: %f seconds\n", name, (unsigned long long)checksum, elapsed);
+    };
+
+    // Pool blocks fit the largest request of the frame so nothing spills to the backing
+    // allocator, whole cache lines keep the 64 byte aligned requests in the pool too
+    TrackingAllocator heapTracking;
+    heapFrame(&heapTracking);
+    TrackingAllocator ecsTracking;
+    ecsFrame(&ecsTracking);
+
+    LinearAllocator frameArena(4 * 1024 * 1024);
+    PoolAllocator heapPool(AlignUp(heapTracking.GetLargestSize(), CACHE_LINE_SIZE), 256);
+    PoolAllocator ecsPool(AlignUp(ecsTracking.GetLargestSize(), CACHE_LINE_SIZE), 256);
+
+    runFrames("Heap malloc", heapFrame, GetDefaultAllocator(), nullptr);
+    runFrames("Heap linear", heapFrame, &frameArena, &frameArena);
+    runFrames("Heap pool", heapFrame, &heapPool, nullptr);
+
+    runFrames("Ecs malloc", ecsFrame, GetDefaultAllocator(), nullptr);
+    runFrames("Ecs linear", ecsFrame, &frameArena, &frameArena);
+    runFrames("Ecs pool", ecsFrame, &ecsPool, nullptr);
+
+    auto printFrameStats = [](const char* name, const TrackingAllocator& tracking)
+    {
+        printf("%s allocations per frame: %llu, bytes: %llu, peak live bytes: %llu, largest: %llu\n", name,
+            (unsigned long long)tracking.GetAllocationCount(),
+            (unsigned long long)tracking.GetBytesAllocated(),
+            (unsigned long long)tracking.GetPeakBytes(),
+            (unsigned long long)tracking.GetLargestSize());
+    };
+    printFrameStats("Heap", heapTracking);
+    printFrameStats("Ecs", ecsTracking);
+}
+
+// Same as T but hides it from IsTriviallyRelocatable, used to measure the element-wise path
+template<class T>
+struct NonRelocatable
+{
+    T value_;
+
+    template<class... ArgsT>
+    NonRelocatable(ArgsT&&... args) : value_(std::forward<ArgsT>(args)...) {}
+};
+
+void RelocationBench()
+{
+    using namespace archetypeECS;
+
+    EnsureEcsTypes();
+
+    constexpr int REPEAT = 100;
+    constexpr int ARR_COUNT = 10'000;
+    constexpr int ARCH_COUNT = 10'000;
+
+    auto growArrays = [](auto& arrays)
+    {
+        for (int i = 0; i < ARR_COUNT; ++i)
+            arrays.EmplaceBack(std::initializer_list<int>{ i, i + 1, i + 2 });
+    };
+
+    auto growArchetypes = [](auto& archetypes)
+    {
+        const Archetype::Type_t type{ TypeInfo<Entity_t>::TypeId(), TypeInfo<Position>::TypeId() };
+        for (int i = 0; i < ARCH_COUNT; ++i)
+            archetypes.EmplaceBack(Archetype(nullptr, type, GetDefaultAllocator()));
+    };
+
+    float relocArr = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            Array<Array<int>> arrays;
+            growArrays(arrays);
+        }
+    });
+
+    float moveArr = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            Array<NonRelocatable<Array<int>>> arrays;
+            growArrays(arrays);
+        }
+    });
+
+    float relocArch = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            Array<Archetype> archetypes;
+            growArchetypes(archetypes);
+        }
+    });
+
+    float moveArch = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            Array<NonRelocatable<Archetype>> archetypes;
+            growArchetypes(archetypes);
+        }
+    });
+
+    printf("Array<Array<int>> growth     relocate: %f, move: %f seconds\n", relocArr, moveArr);
+    printf("Array<Archetype> growth      relocate: %f, move: %f seconds\n", relocArch, moveArch);
+}
+
+void SparseArrayPayloadBench()
+{
+    constexpr uint INSERT_COUNT = 100'000;
+    constexpr uint SLOT_COUNT = 400'000;
+
+    // Random inserts with every third step removing, items shift on both
+    auto churn = [](auto& sa, auto makeItem)
+    {
+        srand(42);
+        for (uint i = 0; i < INSERT_COUNT; ++i)
+        {
+            const uint idx = Rand30() % SLOT_COUNT;
+            sa.Insert(idx, makeItem(idx));
+            if (i % 3 == 0)
+                sa.Remove(Rand30() % SLOT_COUNT);
+        }
+        return sa.Count();
+    };
+
+    uint count = 0;
+    float pod = MeasureSeconds([&]()
+    {
+        SparseArray<uint> sa;
+        count = churn(sa, [](uint idx) { return idx; });
+    });
+
+    // Move only payload owning memory, everything has to be freed at the end
+    TrackingAllocator tracking;
+    auto makeArray = [&tracking](uint idx)
+    {
+        Array<uint> items(&tracking);
+        items.Add(idx);
+        return items;
+    };
+
+    float relocatable = MeasureSeconds([&]()
+    {
+        SparseArray<Array<uint>> sa;
+        churn(sa, makeArray);
+    });
+
+    float nonRelocatable = MeasureSeconds([&]()
+    {
+        SparseArray<NonRelocatable<Array<uint>>> sa;
+        churn(sa, [&](uint idx) { return NonRelocatable<Array<uint>>(makeArray(idx)); });
+    });
+
+    printf("SparseArray churn, %u items  uint: %f, Array<uint>: %f, non relocatable Array<uint>: %f seconds, leaked: %llu B\n",
+        count, pod, relocatable, nonRelocatable, (unsigned long long)tracking.GetLiveBytes());
+}
+
+void ConcurrentSparseArrayBench()
+{
+    constexpr uint SLOT_COUNT = 4'000'000;
+    constexpr uint LOOKUPS_PER_THREAD = 4'000'000;
+    constexpr uint WRITES_PER_PUBLISH = 64;
+    // Each reader thread holds one reader slot of the ConcurrentSparseArray
+    const uint maxThreads = std::min(Max<uint>(std::thread::hardware_concurrency(), 1), ConcurrentSparseArray<uint>::MAX_READERS);
+
+    // Readers do their lookups while the writer keeps inserting into the same array,
+    // makeLookup is called on each reader thread so it can register there. The writer
+    // appends past the filled slots so an insert doesn't move the items after it.
+    auto run = [](uint threadCount, auto makeLookup, auto write)
+    {
+        std::atomic<uint> readersLeft{ threadCount };
+        std::atomic<uint64> found{};
+
+        std::vector<std::thread> threads;
+        for (uint t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                auto lookup = makeLookup();
+                uint64 localFound = 0;
+                uint idx = t * 7919;
+                for (uint i = 0; i < LOOKUPS_PER_THREAD; ++i)
+                {
+                    idx = (idx + 2654435761u) % SLOT_COUNT;
+                    localFound += lookup(idx);
+                }
+                found += localFound;
+                --readersLeft;
+            });
+        }
+
+        uint writes = 0;
+        while (readersLeft.load())
+            write(writes++);
+
+        for (auto& thread : threads)
+            thread.join();
+
+        return writes;
+    };
+
+    auto fill = [](auto& sa)
+    {
+        for (uint i = 0; i < SLOT_COUNT; i += 4)
+            sa.Insert(i, i);
+    };
+
+    for (uint threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+    {
+        SparseArray<uint> lockedArray;
+        fill(lockedArray);
+        std::shared_mutex mutex;
+        uint lockedWrites = 0;
+        float lockedTime = MeasureSeconds([&]()
+        {
+            lockedWrites = run(threadCount, [&]()
+            {
+                return [&](uint idx)
+                {
+                    std::shared_lock<std::shared_mutex> lock(mutex);
+                    return lockedArray.Contains(idx);
+                };
+            }, [&](uint w)
+            {
+                std::unique_lock<std::shared_mutex> lock(mutex);
+                lockedArray.Insert(SLOT_COUNT + w, w);
+            });
+        });
+
+        ConcurrentSparseArray<uint> rcuArray;
+        fill(rcuArray);
+        rcuArray.Publish();
+        uint rcuWrites = 0;
+        uint publishes = 0;
+        float rcuTime = MeasureSeconds([&]()
+        {
+            rcuWrites = run(threadCount, [&]()
+            {
+                // Registered once per thread, entering and exiting a read is just two stores
+                auto reader = std::make_unique<ConcurrentSparseArray<uint>::Reader>(rcuArray);
+                return [reader = std::move(reader)](uint idx)
+                {
+                    ConcurrentSparseArray<uint>::ReadScope snapshot(*reader);
+                    return snapshot->Contains(idx);
+                };
+            }, [&](uint w)
+            {
+                rcuArray.Insert(SLOT_COUNT + w, w);
+                if (w % WRITES_PER_PUBLISH == WRITES_PER_PUBLISH - 1)
+                {
+                    rcuArray.Publish();
+                    ++publishes;
+                }
+            });
+        });
+
+        printf("Readers %2u  shared_mutex SparseArray: %f (%u writes), ConcurrentSparseArray: %f (%u writes, %u publishes, %llu retired) seconds\n",
+            threadCount, lockedTime, lockedWrites, rcuTime, rcuWrites, publishes, (unsigned long long)rcuArray.GetRetiredCount());
+    }
+}
+
+void BulkArrayBench()
+{
+    constexpr int REPEAT = 100;
+    constexpr int ITEM_COUNT = 1'000'000;
+
+    Array<int> source;
+    source.ResizeUninitialized(ITEM_COUNT);
+    for (int i = 0; i < ITEM_COUNT; ++i)
+        source[i] = rand();
+
+    int64_t checksum = 0;
+    float addLoop = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            Array<int> a;
+            for (int i = 0; i < ITEM_COUNT; ++i)
+                a.Add(source[i]);
+            checksum += a.Last();
+        }
+    });
+
+    float addRange = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            Array<int> a;
+            a.AddRange(MakeSpan((const int*)source.Data(), source.Count()));
+            checksum += a.Last();
+        }
+    });
+
+    // Splice a block into the middle of existing data
+    constexpr int SPLICE = 1000;
+    float insertLoop = MeasureSeconds([&]()
+    {
+        Array<int> a;
+        a.AddRange(MakeSpan((const int*)source.Data(), 10 * SPLICE));
+        for (int i = 0; i < SPLICE; ++i)
+            a.Insert(a.Count() / 2 + i, source[i]);
+        checksum += a[a.Count() / 2];
+    });
+
+    float insertRange = MeasureSeconds([&]()
+    {
+        Array<int> a;
+        a.AddRange(MakeSpan((const int*)source.Data(), 10 * SPLICE));
+        a.InsertRange(a.Count() / 2, MakeSpan((const int*)source.Data(), SPLICE));
+        checksum += a[a.Count() / 2];
+    });
+
+    printf("Add loop: %f, AddRange: %f seconds\n", addLoop, addRange);
+    printf("Insert loop: %f, InsertRange: %f seconds, chsm: %lld\n", insertLoop, insertRange, (long long)checksum);
+}
+
+void ArrayRemoveBench()
+{
+    constexpr int ITEM_COUNT = 100'000;
+    constexpr int REMOVE_COUNT = 50'000;
+
+    Array<int> source;
+    source.ResizeUninitialized(ITEM_COUNT);
+    for (int i = 0; i < ITEM_COUNT; ++i)
+        source[i] = rand();
+
+    Array<uint64> removeIndices;
+    for (uint64 i = 0; i < ITEM_COUNT; i += ITEM_COUNT / REMOVE_COUNT)
+        removeIndices.Add(i);
+
+    int64_t checksum = 0;
+    auto sum = [&checksum](Array<int>& a)
+    {
+        for (int x : a)
+            checksum += x;
+    };
+
+    float remove = MeasureSeconds([&]()
+    {
+        Array<int> a;
+        a.AddRange(MakeSpan((const int*)source.Data(), source.Count()));
+        for (int i = 0; i < REMOVE_COUNT; ++i)
+            a.Remove(rand() % a.Count());
+        sum(a);
+    });
+
+    float removeSwap = MeasureSeconds([&]()
+    {
+        Array<int> a;
+        a.AddRange(MakeSpan((const int*)source.Data(), source.Count()));
+        for (int i = 0; i < REMOVE_COUNT; ++i)
+            a.RemoveSwapBack(rand() % a.Count());
+        sum(a);
+    });
+
+    // Removing marked indices, one by one from the back vs a single sweep
+    float removeMarked = MeasureSeconds([&]()
+    {
+        Array<int> a;
+        a.AddRange(MakeSpan((const int*)source.Data(), source.Count()));
+        for (uint64 i = removeIndices.Count(); i-- > 0;)
+            a.Remove(removeIndices[i]);
+        sum(a);
+    });
+
+    float removeIndicesTime = MeasureSeconds([&]()
+    {
+        Array<int> a;
+        a.AddRange(MakeSpan((const int*)source.Data(), source.Count()));
+        a.RemoveIndices(MakeSpan((const uint64*)removeIndices.Data(), removeIndices.Count()));
+        sum(a);
+    });
+
+    float removeIf = MeasureSeconds([&]()
+    {
+        Array<int> a;
+        a.AddRange(MakeSpan((const int*)source.Data(), source.Count()));
+        a.RemoveIf([](int x) { return x & 1; });
+        sum(a);
+    });
+
+    printf("Remove random: %f, RemoveSwapBack random: %f seconds\n", remove, removeSwap);
+    printf("Remove marked: %f, RemoveIndices: %f, RemoveIf: %f seconds, chsm: %lld\n",
+        removeMarked, removeIndicesTime, removeIf, (long long)checksum);
+}
+
+void StableArrayBench()
+{
+    constexpr int REPEAT = 20;
+    constexpr int ITEM_COUNT = 10'000'000;
+
+    int64_t checksum = 0;
+
+    float arrayAdd = MeasureSeconds([&]()
+    {
+        Array<int> a;
+        for (int i = 0; i < ITEM_COUNT; ++i)
+            a.Add(i);
+        checksum += a.Last();
+    });
+
+    float stableAdd = MeasureSeconds([&]()
+    {
+        StableArray<int, 12> a;
+        for (int i = 0; i < ITEM_COUNT; ++i)
+            a.Add(i);
+        checksum += a.Last();
+    });
+
+    Array<int> array;
+    StableArray<int, 12> stable;
+    for (int i = 0; i < ITEM_COUNT; ++i)
+    {
+        array.Add(i);
+        stable.Add(i);
+    }
+
+    float arrayIter = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+            for (int x : array)
+                checksum += x;
+    });
+
+    float stableIter = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+            for (int x : stable)
+                checksum += x;
+    });
+
+    float stableChunkIter = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            for (uint64 c = 0; c < stable.ChunkCount(); ++c)
+            {
+                Span<int> chunk = stable.GetChunk(c);
+                for (uint64 i = 0; i < chunk.Count(); ++i)
+                    checksum += chunk[i];
+            }
+        }
+    });
+
+    float arrayIndex = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+            for (uint64 i = 0; i < array.Count(); ++i)
+                checksum += array[i];
+    });
+
+    float stableIndex = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+            for (uint64 i = 0; i < stable.Count(); ++i)
+                checksum += stable[i];
+    });
+
+    printf("Add        Array: %f, StableArray: %f seconds\n", arrayAdd, stableAdd);
+    printf("Iterate    Array: %f, StableArray: %f, by chunks: %f seconds\n", arrayIter, stableIter, stableChunkIter);
+    printf("Index      Array: %f, StableArray: %f seconds, chsm: %lld\n", arrayIndex, stableIndex, (long long)checksum);
+}
+
+void ArrayGrowthBench()
+{
+    constexpr int ARRAY_COUNT = 1000;
+    constexpr int MAX_ITEMS = 20'000;
+
+    // Many arrays of random sizes growing side by side like under load
+    auto run = [](const char* name, ArrayGrowth growth)
+    {
+        TrackingAllocator tracking;
+        uint64 capacity = 0;
+        uint64 count = 0;
+        uint64 reallocations = 0;
+        uint64 shrunkBytes = 0;
+
+        srand(42);
+        float elapsed = MeasureSeconds([&]()
+        {
+            Array<Array<int>> arrays;
+            arrays.Reserve(ARRAY_COUNT);
+            for (int i = 0; i < ARRAY_COUNT; ++i)
+            {
+                arrays.EmplaceBack(&tracking);
+                arrays.Last().SetGrowth(growth);
+            }
+
+            for (int i = 0; i < ARRAY_COUNT; ++i)
+            {
+                const int items = rand() % MAX_ITEMS;
+                for (int j = 0; j < items; ++j)
+                    arrays[i].Add(j);
+            }
+
+            for (int i = 0; i < ARRAY_COUNT; ++i)
+            {
+                capacity += arrays[i].Capacity();
+                count += arrays[i].Count();
+            }
+
+            // Every growth of an item buffer, the first one from empty included, HS_ARRAY_STATS
+            // or not (only the item buffers use the tracking allocator)
+            reallocations = tracking.GetAllocationCount() + tracking.GetReallocationCount();
+
+            // Drop the spike and give back the slack
+            for (int i = 0; i < ARRAY_COUNT; ++i)
+            {
+                if (i & 1)
+                    arrays[i].Reset();
+                else
+                    arrays[i].ShrinkToFit();
+            }
+            shrunkBytes = tracking.GetLiveBytes();
+        });
+
+        printf("%-12s elapsed: %f seconds, used %.1f%% of capacity, reallocations: %llu, peak: %llu KB, after shrink: %llu KB\n",
+            name, elapsed, 100.0 * count / capacity,
+            (unsigned long long)reallocations,
+            (unsigned long long)tracking.GetPeakBytes() / 1024,
+            (unsigned long long)shrunkBytes / 1024);
+    };
+
+    run("Double", ArrayGrowth::Double);
+    run("OneAndHalf", ArrayGrowth::OneAndHalf);
+}
+
+void SoaBench()
+{
+    constexpr int REPEAT = 100;
+    constexpr int ENT_COUNT = 1'000'000;
+
+    // Movement system touching only x, y of simpleECS transforms
+    Array<simpleECS::TransformComponent> aosTransforms;
+    SoaArray<simpleECS::Entity_t, float, float> soaTransforms;
+    for (int i = 0; i < ENT_COUNT; ++i)
+    {
+        aosTransforms.Add(simpleECS::TransformComponent{ (uint)i, (float)i, (float)-i });
+        soaTransforms.Add((uint)i, (float)i, (float)-i);
+    }
+
+    float aosMove = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            for (uint64 i = 0; i < aosTransforms.Count(); ++i)
+            {
+                aosTransforms[i].x += 0.1f;
+                aosTransforms[i].y += 0.2f;
+            }
+        }
+    });
+
+    float soaMove = MeasureSeconds([&]()
+    {
+        for (int r = 0; r < REPEAT; ++r)
+        {
+            Span<float> xs = soaTransforms.Column<1>();
+            Span<float> ys = soaTransforms.Column<2>();
+            for (uint64 i = 0; i < xs.Count(); ++i)
+            {
+                xs[i] += 0.1f;
+                ys[i] += 0.2f;
+            }
+        }
+    });
+
+    // Closest seed search of Voronoi reads only the coordinates of the seeds
+    constexpr int SEED_COUNT = 4096;
+    constexpr int QUERY_COUNT = 4096;
+    Array<SeedPoint> aosSeeds;
+    SoaArray<float, float, uint> soaSeeds;
+    for (int i = 0; i < SEED_COUNT; ++i)
+    {
+        SeedPoint seed{ (int16)(rand() % 1024), (int16)(rand() % 1024), (uint)rand() };
+        aosSeeds.Add(seed);
+        soaSeeds.Add(seed.X, seed.Y, seed.Color);
+    }
+
+    uint64 checksum = 0;
+    float aosSeedSearch = MeasureSeconds([&]()
+    {
+        for (int q = 0; q < QUERY_COUNT; ++q)
+        {
+            const float x = (float)(q % 1024);
+            const float y = (float)(q / 4);
+            float closest = FLT_MAX;
+            for (uint64 i = 0; i < aosSeeds.Count(); ++i)
+            {
+                const float dx = aosSeeds[i].X - x;
+                const float dy = aosSeeds[i].Y - y;
+                closest = std::min(closest, dx * dx + dy * dy);
+            }
+            checksum += (uint64)closest;
+        }
+    });
+
+    float soaSeedSearch = MeasureSeconds([&]()
+    {
+        Span<const float> xs = soaSeeds.Column<0>();
+        Span<const float> ys = soaSeeds.Column<1>();
+        for (int q = 0; q < QUERY_COUNT; ++q)
+        {
+            const float x = (float)(q % 1024);
+            const float y = (float)(q / 4);
+            float closest = FLT_MAX;
+            for (uint64 i = 0; i < xs.Count(); ++i)
+            {
+                const float dx = xs[i] - x;
+                const float dy = ys[i] - y;
+                closest = std::min(closest, dx * dx + dy * dy);
+            }
+            checksum += (uint64)closest;
+        }
+    });
+
+    float zipped = 0;
+    for (auto [entity, x, y] : soaTransforms)
+        zipped += x + y;
+
+    printf("Movement      AoS: %f, SoA: %f seconds\n", aosMove, soaMove);
+    printf("Seed search   AoS: %f, SoA: %f seconds, chsm: %llu, %f\n", aosSeedSearch, soaSeedSearch, (unsigned long long)checksum, zipped);
+}
+
+void ConcurrentArrayBench()
+{
+    constexpr uint64 ITEM_COUNT = 4'000'000;
+    const uint maxThreads = Max<uint>(std::thread::hardware_concurrency(), 1);
+
+    // Every thread appends its share of the values, all variants must end with the same sum
+    auto runProducers = [](uint threadCount, auto addItem)
+    {
+        std::vector<std::thread> threads;
+        const uint64 perThread = ITEM_COUNT / threadCount;
+        for (uint t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([=]()
+            {
+                for (uint64 i = t * perThread; i < (t + 1) * perThread; ++i)
+                    addItem(i);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+    };
+
+    for (uint threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+    {
+        Array<uint64> lockedArray;
+        std::mutex mutex;
+        float mutexTime = MeasureSeconds([&]()
+        {
+            runProducers(threadCount, [&](uint64 value)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                lockedArray.Add(value);
+            });
+        });
+
+        ConcurrentArray<uint64> growingArray;
+        float growingTime = MeasureSeconds([&]()
+        {
+            runProducers(threadCount, [&](uint64 value) { growingArray.AddAtomic(value); });
+        });
+
+        ConcurrentArray<uint64> reservedArray;
+        reservedArray.Reserve(ITEM_COUNT);
+        float reservedTime = MeasureSeconds([&]()
+        {
+            runProducers(threadCount, [&](uint64 value) { reservedArray.AddAtomic(value); });
+        });
+
+        uint64 lockedSum = 0;
+        for (uint64 v : lockedArray)
+            lockedSum += v;
+
+        uint64 growingSum = 0;
+        uint64 reservedSum = 0;
+        for (uint64 i = 0; i < growingArray.Count(); ++i)
+        {
+            growingSum += growingArray[i];
+            reservedSum += reservedArray[i];
+        }
+        hs_assert(lockedSum == growingSum && growingSum == reservedSum);
+
+        printf("Threads %2u  mutex Array: %f, ConcurrentArray: %f, reserved: %f seconds, chsm: %llu\n",
+            threadCount, mutexTime, growingTime, reservedTime, (unsigned long long)reservedSum);
+    }
+}
+
 
 // Include here because of clases with flecs macros
 #include "flecs/flecs.h"
@@ -328,9 +2119,31 @@ void FlecsTest()
 int main()
 {
     //SparseArrayTest();
+    //SparseArrayIterBench();
+    //BucketSparseArrayBench();
+    //SparseArrayBulkBench();
+    //SparseArrayLookupBench();
+    //HierarchicalSparseArrayBench();
+    //SparseSetBench();
+    //SparseArrayPayloadBench();
+    //ConcurrentSparseArrayBench();
     //ArrayTest();
+    //InlineArrayTest();
+    //SpanSplitTest();
+    //Span2DTest();
 
     //HeapVsSortedArrayBench();
+    //MultiQueueBench();
+    //HeapBench();
+    //DijkstraBench();
+    //AllocatorBench();
+    //RelocationBench();
+    //BulkArrayBench();
+    //ArrayRemoveBench();
+    //StableArrayBench();
+    //ArrayGrowthBench();
+    //SoaBench();
+    //ConcurrentArrayBench();
 
     //VoronoiTest();
 